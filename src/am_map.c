@@ -88,6 +88,9 @@
 #define TSWALLPRIORITY          2
 #define GRIDPRIORITY            1
 
+// the grid stays at the original mapblock size whatever blockmap_size is
+#define GRIDSIZE                (128 * FRACUNIT)
+
 byte    *priorities;
 byte    *mask;
 
@@ -1398,12 +1401,12 @@ static void AM_drawGrid(void)
 
     // Figure out start of vertical gridlines
     start = m_x - extx;
-    if ((start - bmaporgx) % MAPBLOCKSIZE)
-        start += MAPBLOCKSIZE - ((start - bmaporgx) % MAPBLOCKSIZE);
+    if ((start - bmaporgx) % GRIDSIZE)
+        start += GRIDSIZE - ((start - bmaporgx) % GRIDSIZE);
     end = m_x + minlen - extx;
 
     // draw vertical gridlines
-    for (x = start; x < end; x += MAPBLOCKSIZE)
+    for (x = start; x < end; x += GRIDSIZE)
     {
         ml.a.x = x;
         ml.b.x = x;
@@ -1419,12 +1422,12 @@ static void AM_drawGrid(void)
 
     // Figure out start of horizontal gridlines
     start = m_y - exty;
-    if ((start - bmaporgy) % MAPBLOCKSIZE)
-        start += MAPBLOCKSIZE - ((start - bmaporgy) % MAPBLOCKSIZE);
+    if ((start - bmaporgy) % GRIDSIZE)
+        start += GRIDSIZE - ((start - bmaporgy) % GRIDSIZE);
     end = m_y + minlen - exty;
 
     // draw horizontal gridlines
-    for (y = start; y < end; y += MAPBLOCKSIZE)
+    for (y = start; y < end; y += GRIDSIZE)
     {
         ml.a.x = m_x - extx;
         ml.b.x = ml.a.x + minlen;
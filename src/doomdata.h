@@ -201,6 +201,54 @@ typedef struct
 
 } PACKEDATTR mapnode_t;
 
+// DeePBSP extended nodes, with 32-bit indexes.
+// The NODES lump starts with the signature "xNd4\0\0\0\0".
+typedef struct
+{
+    unsigned short      numsegs;
+    int                 firstseg;
+} PACKEDATTR mapsubsector_v4_t;
+
+typedef struct
+{
+    int                 v1;
+    int                 v2;
+    unsigned short      angle;
+    unsigned short      linedef;
+    short               side;
+    unsigned short      offset;
+} PACKEDATTR mapseg_v4_t;
+
+typedef struct
+{
+    short               x;
+    short               y;
+    short               dx;
+    short               dy;
+    short               bbox[2][4];
+    int                 children[2];
+} PACKEDATTR mapnode_v4_t;
+
+// ZDoom extended nodes. The NODES lump starts with "XNOD", and holds the
+// new vertexes, subsectors, segs and nodes in that order.
+typedef struct
+{
+    unsigned int        v1;
+    unsigned int        v2;
+    unsigned short      linedef;
+    unsigned char       side;
+} PACKEDATTR mapseg_znod_t;
+
+typedef struct
+{
+    short               x;
+    short               y;
+    short               dx;
+    short               dy;
+    short               bbox[2][4];
+    int                 children[2];
+} PACKEDATTR mapnode_znod_t;
+
 // Thing definition, position, orientation and type,
 // plus skill/visibility flags and attributes.
 typedef struct
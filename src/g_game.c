@@ -1578,6 +1578,7 @@ void G_DoLoadGame(void)
     // dearchive all the modifications
     P_UnArchivePlayers();
     P_UnArchiveWorld();
+    P_UpdateAllSoundOpenings();
     P_UnArchiveThinkers();
     P_UnArchiveSpecials();
 
@@ -177,6 +177,14 @@ static int ZenityErrorBox(char *message)
 
 #endif
 
+//
+// I_HasSSE2
+//
+boolean I_HasSSE2(void)
+{
+    return (SDL_HasSSE2() == SDL_TRUE);
+}
+
 //
 // I_Error
 //
@@ -45,6 +45,9 @@ void I_Quit(boolean shutdown);
 
 void I_Error(char *error, ...);
 
+// Whether the CPU supports SSE2 instructions.
+boolean I_HasSSE2(void);
+
 extern boolean widescreen;
 extern boolean hud;
 extern boolean returntowidescreen;
@@ -40,6 +40,7 @@
 // DEFAULTS
 //
 extern boolean  alwaysrun;
+extern int      blockmapsize;
 extern int      bloodsplats;
 extern boolean  brightmaps;
 extern int      corpses;
@@ -181,6 +182,7 @@ typedef struct
 static default_t doom_defaults_list[] =
 {
     CONFIG_VARIABLE_INT   (alwaysrun,           alwaysrun,            1),
+    CONFIG_VARIABLE_INT   (blockmap_size,       blockmapsize,         0),
     CONFIG_VARIABLE_INT   (bloodsplats,         bloodsplats,          7),
     CONFIG_VARIABLE_INT   (brightmaps,          brightmaps,           1),
     CONFIG_VARIABLE_INT   (corpses,             corpses,             11),
@@ -701,6 +703,10 @@ static void M_CheckDefaults(void)
     if (alwaysrun != false && alwaysrun != true)
         alwaysrun = ALWAYSRUN_DEFAULT;
 
+    if (blockmapsize < BLOCKMAPSIZE_MIN || blockmapsize > BLOCKMAPSIZE_MAX
+        || (blockmapsize & (blockmapsize - 1)))
+        blockmapsize = BLOCKMAPSIZE_DEFAULT;
+
     if (bloodsplats < BLOODSPLATS_MIN || BLOODSPLATS_MAX)
         bloodsplats = BLOODSPLATS_DEFAULT;
 
@@ -28,6 +28,10 @@
 
 #define ALWAYSRUN_DEFAULT               false
 
+#define BLOCKMAPSIZE_MIN                32
+#define BLOCKMAPSIZE_DEFAULT            128
+#define BLOCKMAPSIZE_MAX                128
+
 #define BLOODSPLATS_MIN                 0
 #define BLOODSPLATS_DEFAULT             UNLIMITED
 #define BLOODSPLATS_MAX                 UNLIMITED
@@ -0,0 +1,422 @@
+/*
+========================================================================
+
+  DOOM RETRO
+  The classic, refined DOOM source port. For Windows PC.
+  Copyright (C) 2013-2014 Brad Harding.
+
+  This file is part of DOOM RETRO.
+
+  DOOM RETRO is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  DOOM RETRO is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with DOOM RETRO. If not, see <http://www.gnu.org/licenses/>.
+
+========================================================================
+*/
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "i_system.h"
+#include "m_inflate.h"
+
+//
+// A small decoder for the DEFLATE format (RFC 1951) wrapped in a zlib
+// header (RFC 1950), written along the lines of Mark Adler's puff.c. It
+// decodes a bit at a time, which is plenty for the few lumps that need it.
+//
+#define MAXBITS         15      // longest Huffman code
+#define MAXLCODES       286     // literal/length codes
+#define MAXDCODES       30      // distance codes
+#define FIXLCODES       288     // literal/length codes in the fixed table
+
+typedef struct
+{
+    const byte  *in;
+    int         inlength;
+    int         incount;
+    int         bitbuf;
+    int         bitcount;
+
+    byte        *out;
+    int         outlength;
+    int         outcount;
+
+    boolean     error;
+} inflatestate_t;
+
+typedef struct
+{
+    short       count[MAXBITS + 1];     // codes of each length
+    short       symbol[FIXLCODES];      // symbols in canonical order
+} huffman_t;
+
+static int M_InflateBits(inflatestate_t *s, int need)
+{
+    int val = s->bitbuf;
+
+    while (s->bitcount < need)
+    {
+        if (s->incount == s->inlength)
+        {
+            s->error = true;
+            return 0;
+        }
+        val |= (int)s->in[s->incount++] << s->bitcount;
+        s->bitcount += 8;
+    }
+
+    s->bitbuf = val >> need;
+    s->bitcount -= need;
+    return (val & ((1 << need) - 1));
+}
+
+static boolean M_InflateOutput(inflatestate_t *s, int count)
+{
+    if (s->outcount + count > s->outlength)
+    {
+        int     outlength = s->outlength;
+
+        while (s->outcount + count > outlength)
+            outlength = (outlength > INT_MAX / 2 ? INT_MAX : outlength * 2);
+        if (s->outcount + count > outlength)
+            return false;
+
+        if (!(s->out = (byte *)realloc(s->out, outlength)))
+            I_Error("M_Inflate: Failure trying to allocate %i bytes", outlength);
+        s->outlength = outlength;
+    }
+    return true;
+}
+
+static boolean M_InflateStored(inflatestate_t *s)
+{
+    int length;
+
+    // discard the rest of the current byte
+    s->bitbuf = 0;
+    s->bitcount = 0;
+
+    if (s->incount + 4 > s->inlength)
+        return false;
+    length = s->in[s->incount] | (s->in[s->incount + 1] << 8);
+    if ((s->in[s->incount + 2] | (s->in[s->incount + 3] << 8)) != (~length & 0xFFFF))
+        return false;
+    s->incount += 4;
+
+    if (s->incount + length > s->inlength || !M_InflateOutput(s, length))
+        return false;
+    memcpy(s->out + s->outcount, s->in + s->incount, length);
+    s->incount += length;
+    s->outcount += length;
+    return true;
+}
+
+//
+// M_InflateDecode
+// Returns the next symbol decoded with h, or -1 if there is no such code.
+//
+static int M_InflateDecode(inflatestate_t *s, const huffman_t *h)
+{
+    int code = 0;       // bits read so far
+    int first = 0;      // first code of the current length
+    int index = 0;      // index of that code in symbol[]
+    int len;
+
+    for (len = 1; len <= MAXBITS; len++)
+    {
+        int     count = h->count[len];
+
+        code |= M_InflateBits(s, 1);
+        if (s->error)
+            return -1;
+        if (code - count < first)
+            return h->symbol[index + (code - first)];
+        index += count;
+        first = (first + count) << 1;
+        code <<= 1;
+    }
+    return -1;
+}
+
+//
+// M_InflateConstruct
+// Builds h from the code lengths of n symbols. Returns false if the
+// lengths ask for more codes than there are.
+//
+static boolean M_InflateConstruct(huffman_t *h, const short *length, int n)
+{
+    short       offs[MAXBITS + 1];
+    int         left = 1;
+    int         symbol;
+    int         len;
+
+    memset(h->count, 0, sizeof(h->count));
+    for (symbol = 0; symbol < n; symbol++)
+        h->count[length[symbol]]++;
+
+    for (len = 1; len <= MAXBITS; len++)
+    {
+        left <<= 1;
+        left -= h->count[len];
+        if (left < 0)
+            return false;
+    }
+
+    offs[1] = 0;
+    for (len = 1; len < MAXBITS; len++)
+        offs[len + 1] = offs[len] + h->count[len];
+
+    for (symbol = 0; symbol < n; symbol++)
+        if (length[symbol])
+            h->symbol[offs[length[symbol]]++] = symbol;
+    return true;
+}
+
+static boolean M_InflateCodes(inflatestate_t *s, const huffman_t *lencode, const huffman_t *distcode)
+{
+    static const short  lbase[29] =
+    {
+        3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+        35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+    };
+    static const short  lext[29] =
+    {
+        0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+        3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+    };
+    static const short  dbase[30] =
+    {
+        1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+        257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+        8193, 12289, 16385, 24577
+    };
+    static const short  dext[30] =
+    {
+        0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+        7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+    };
+
+    while (1)
+    {
+        int     symbol = M_InflateDecode(s, lencode);
+
+        if (symbol < 0)
+            return false;
+        else if (symbol < 256)
+        {
+            if (!M_InflateOutput(s, 1))
+                return false;
+            s->out[s->outcount++] = (byte)symbol;
+        }
+        else if (symbol == 256)
+            return true;
+        else
+        {
+            int len, dist;
+
+            symbol -= 257;
+            if (symbol >= 29)
+                return false;
+            len = lbase[symbol] + M_InflateBits(s, lext[symbol]);
+
+            symbol = M_InflateDecode(s, distcode);
+            if (symbol < 0 || symbol >= 30)
+                return false;
+            dist = dbase[symbol] + M_InflateBits(s, dext[symbol]);
+
+            if (s->error || dist > s->outcount || !M_InflateOutput(s, len))
+                return false;
+
+            // the copy can overlap what it writes, so it goes a byte at a time
+            while (len--)
+            {
+                s->out[s->outcount] = s->out[s->outcount - dist];
+                s->outcount++;
+            }
+        }
+    }
+}
+
+static boolean M_InflateFixed(inflatestate_t *s)
+{
+    static boolean      built = false;
+    static huffman_t    lencode, distcode;
+
+    if (!built)
+    {
+        short   lengths[FIXLCODES];
+        int     symbol;
+
+        for (symbol = 0; symbol < 144; symbol++)
+            lengths[symbol] = 8;
+        for (; symbol < 256; symbol++)
+            lengths[symbol] = 9;
+        for (; symbol < 280; symbol++)
+            lengths[symbol] = 7;
+        for (; symbol < FIXLCODES; symbol++)
+            lengths[symbol] = 8;
+        M_InflateConstruct(&lencode, lengths, FIXLCODES);
+
+        for (symbol = 0; symbol < MAXDCODES; symbol++)
+            lengths[symbol] = 5;
+        M_InflateConstruct(&distcode, lengths, MAXDCODES);
+        built = true;
+    }
+
+    return M_InflateCodes(s, &lencode, &distcode);
+}
+
+static boolean M_InflateDynamic(inflatestate_t *s)
+{
+    static const short  order[19] =
+    {
+        16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+    };
+    short               lengths[MAXLCODES + MAXDCODES];
+    huffman_t           lencode, distcode;
+    int                 nlen = M_InflateBits(s, 5) + 257;
+    int                 ndist = M_InflateBits(s, 5) + 1;
+    int                 ncode = M_InflateBits(s, 4) + 4;
+    int                 index;
+
+    if (s->error || nlen > MAXLCODES || ndist > MAXDCODES)
+        return false;
+
+    // the code lengths of the code lengths
+    for (index = 0; index < ncode; index++)
+        lengths[order[index]] = M_InflateBits(s, 3);
+    for (; index < 19; index++)
+        lengths[order[index]] = 0;
+    if (s->error || !M_InflateConstruct(&lencode, lengths, 19))
+        return false;
+
+    // the code lengths of the literal/length and distance codes
+    index = 0;
+    while (index < nlen + ndist)
+    {
+        int     symbol = M_InflateDecode(s, &lencode);
+        int     len = 0;
+        int     repeat;
+
+        if (symbol < 0)
+            return false;
+        else if (symbol < 16)
+        {
+            lengths[index++] = symbol;
+            continue;
+        }
+        else if (symbol == 16)
+        {
+            if (!index)
+                return false;
+            len = lengths[index - 1];
+            repeat = 3 + M_InflateBits(s, 2);
+        }
+        else if (symbol == 17)
+            repeat = 3 + M_InflateBits(s, 3);
+        else
+            repeat = 11 + M_InflateBits(s, 7);
+
+        if (s->error || index + repeat > nlen + ndist)
+            return false;
+        while (repeat--)
+            lengths[index++] = len;
+    }
+
+    // there must be a code for the end of the block
+    if (!lengths[256])
+        return false;
+
+    if (!M_InflateConstruct(&lencode, lengths, nlen)
+        || !M_InflateConstruct(&distcode, lengths + nlen, ndist))
+        return false;
+
+    return M_InflateCodes(s, &lencode, &distcode);
+}
+
+//
+// M_Inflate
+//
+byte *M_Inflate(const byte *data, int length, int *outlength)
+{
+    inflatestate_t      s;
+    boolean             last;
+    uint32_t            a = 1, b = 0;
+    int                 i;
+
+    // the zlib header: deflate, no preset dictionary
+    if (length < 6 || (data[0] & 0x0F) != 8 || ((data[0] << 8) | data[1]) % 31 || (data[1] & 0x20))
+        return NULL;
+
+    memset(&s, 0, sizeof(s));
+    s.in = data + 2;
+    s.inlength = length - 6;
+    s.outlength = (length < 256 ? 1024 : (length < INT_MAX / 4 ? length * 4 : INT_MAX));
+    if (!(s.out = (byte *)malloc(s.outlength)))
+        I_Error("M_Inflate: Failure trying to allocate %i bytes", s.outlength);
+
+    do
+    {
+        int     type;
+        boolean result;
+
+        last = M_InflateBits(&s, 1);
+        type = M_InflateBits(&s, 2);
+        if (s.error)
+            break;
+
+        if (type == 0)
+            result = M_InflateStored(&s);
+        else if (type == 1)
+            result = M_InflateFixed(&s);
+        else if (type == 2)
+            result = M_InflateDynamic(&s);
+        else
+            result = false;
+
+        if (!result || s.error)
+        {
+            s.error = true;
+            break;
+        }
+    } while (!last);
+
+    // the Adler-32 checksum of the data follows
+    if (!s.error)
+    {
+        const byte      *p = data + 2 + s.incount;
+
+        if (p + 4 > data + length)
+            s.error = true;
+        else
+        {
+            for (i = 0; i < s.outcount; i++)
+            {
+                a = (a + s.out[i]) % 65521;
+                b = (b + a) % 65521;
+            }
+            if (((b << 16) | a) != (((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3]))
+                s.error = true;
+        }
+    }
+
+    if (s.error)
+    {
+        free(s.out);
+        return NULL;
+    }
+
+    *outlength = s.outcount;
+    return s.out;
+}
@@ -0,0 +1,36 @@
+/*
+========================================================================
+
+  DOOM RETRO
+  The classic, refined DOOM source port. For Windows PC.
+  Copyright (C) 2013-2014 Brad Harding.
+
+  This file is part of DOOM RETRO.
+
+  DOOM RETRO is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  DOOM RETRO is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with DOOM RETRO. If not, see <http://www.gnu.org/licenses/>.
+
+========================================================================
+*/
+
+#ifndef __M_INFLATE__
+#define __M_INFLATE__
+
+#include "doomtype.h"
+
+// Decompresses a zlib stream, such as the body of a ZNOD lump. Returns a
+// buffer allocated with malloc() holding the data and its length, or NULL
+// if the stream is corrupt.
+byte *M_Inflate(const byte *data, int length, int *outlength);
+
+#endif
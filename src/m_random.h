@@ -37,4 +37,7 @@ void M_ClearRandom(void);
 
 int M_RandomInt(int, int);
 
+// The index into the table used by P_Random.
+extern int prndindex;
+
 #endif
@@ -28,6 +28,7 @@
 #include "m_random.h"
 #include "p_local.h"
 #include "s_sound.h"
+#include "z_zone.h"
 
 typedef enum
 {
@@ -78,54 +79,175 @@ void A_Fall(mobj_t *actor);
 //
 
 //
-// Called by P_NoiseAlert.
-// Recursively traverse adjacent sectors,
-// sound blocking lines cut off traversal.
+// SOUND PROPAGATION
+// The sectors that sound can travel to from each sector, through which
+// two-sided lines, and whether those lines block sound, are stored in
+// contiguous arrays when the level is set up. Whether each of those lines
+// is open is kept up to date as sectors move, so P_NoiseAlert doesn't need
+// to call P_LineOpening.
 //
+typedef struct
+{
+    int         sector;
+    int         line;
+    boolean     soundblock;
+} soundneighbour_t;
+
+static soundneighbour_t *soundneighbours;
+static int              *firstsoundneighbour;   // [numsectors + 1]
+static boolean          *soundlineopen;         // [numlines]
 
-void P_RecursiveSound(sector_t *sec, int soundblocks, mobj_t *soundtarget)
+// sectors still to be flooded by P_NoiseAlert
+typedef struct
 {
-    int i;
+    int         sector;
+    int         soundblocks;
+} soundflood_t;
 
-    // wake up all monsters in this sector
-    if (sec->validcount == validcount && sec->soundtraversed <= soundblocks + 1)
-        return;         // already flooded
+static soundflood_t     *soundfloodstack;
 
-    sec->validcount = validcount;
-    sec->soundtraversed = soundblocks + 1;
-    sec->soundtarget = soundtarget;
+static void P_UpdateSoundLineOpening(line_t *line)
+{
+    sector_t    *front = line->frontsector;
+    sector_t    *back = line->backsector;
+    fixed_t     top, bottom;
 
-    for (i = 0; i < sec->linecount; i++)
+    // same as openrange > 0 after P_LineOpening
+    if (line->sidenum[1] == NO_INDEX)
     {
-        sector_t        *other;
-        line_t          *check = sec->lines[i];
+        soundlineopen[line - lines] = false;
+        return;
+    }
 
-        if (!(check->flags & ML_TWOSIDED))
-            continue;
+    top = (front->ceilingheight < back->ceilingheight ? front->ceilingheight :
+        back->ceilingheight);
+    bottom = (front->floorheight > back->floorheight ? front->floorheight : back->floorheight);
+
+    soundlineopen[line - lines] = (top - bottom > 0);
+}
+
+//
+// P_InitSoundNeighbours
+// Called by P_SetupLevel after P_GroupLines.
+//
+void P_InitSoundNeighbours(void)
+{
+    int         i, j;
+    int         count = 0;
 
-        P_LineOpening(check);
+    for (i = 0; i < numsectors; i++)
+        for (j = 0; j < sectors[i].linecount; j++)
+            if (sectors[i].lines[j]->flags & ML_TWOSIDED)
+                count++;
 
-        if (openrange <= 0)
-            continue;   // closed door
+    soundneighbours = Z_Malloc((count + 1) * sizeof(*soundneighbours), PU_LEVEL, NULL);
+    firstsoundneighbour = Z_Malloc((numsectors + 1) * sizeof(*firstsoundneighbour), PU_LEVEL,
+        NULL);
+    soundlineopen = Z_Malloc((numlines + 1) * sizeof(*soundlineopen), PU_LEVEL, NULL);
 
-        other = sides[check->sidenum[sides[check->sidenum[0]].sector == sec]].sector;
+    // every sector is flooded at most twice, once for each value of soundblocks
+    soundfloodstack = Z_Malloc((count * 2 + 1) * sizeof(*soundfloodstack), PU_LEVEL, NULL);
 
-        if (!(check->flags & ML_SOUNDBLOCK))
-            P_RecursiveSound(other, soundblocks, soundtarget);
-        else if (!soundblocks)
-            P_RecursiveSound(other, 1, soundtarget);
+    for (i = 0, count = 0; i < numsectors; i++)
+    {
+        sector_t        *sec = &sectors[i];
+
+        firstsoundneighbour[i] = count;
+
+        for (j = 0; j < sec->linecount; j++)
+        {
+            line_t      *check = sec->lines[j];
+
+            if (!(check->flags & ML_TWOSIDED))
+                continue;
+
+            soundneighbours[count].sector =
+                sides[check->sidenum[sides[check->sidenum[0]].sector == sec]].sector - sectors;
+            soundneighbours[count].line = check - lines;
+            soundneighbours[count].soundblock = !!(check->flags & ML_SOUNDBLOCK);
+            count++;
+        }
     }
+    firstsoundneighbour[numsectors] = count;
+
+    P_UpdateAllSoundOpenings();
+}
+
+//
+// P_UpdateSoundOpenings
+// Called by P_ChangeSector whenever a sector moves.
+//
+void P_UpdateSoundOpenings(sector_t *sector)
+{
+    int i;
+
+    for (i = 0; i < sector->linecount; i++)
+        if (sector->lines[i]->flags & ML_TWOSIDED)
+            P_UpdateSoundLineOpening(sector->lines[i]);
+}
+
+void P_UpdateAllSoundOpenings(void)
+{
+    int i;
+
+    for (i = 0; i < numlines; i++)
+        if (lines[i].flags & ML_TWOSIDED)
+            P_UpdateSoundLineOpening(&lines[i]);
 }
 
 //
 // P_NoiseAlert
 // If a monster yells at a player,
 // it will alert other monsters to the player.
+// Floods adjacent sectors, sound blocking lines cut off traversal.
 //
 void P_NoiseAlert(mobj_t *target, mobj_t *emmiter)
 {
+    int count = 0;
+
     validcount++;
-    P_RecursiveSound(emmiter->subsector->sector, 0, target);
+
+    soundfloodstack[count].sector = emmiter->subsector->sector - sectors;
+    soundfloodstack[count++].soundblocks = 0;
+
+    while (count)
+    {
+        soundflood_t    flood = soundfloodstack[--count];
+        sector_t        *sec = &sectors[flood.sector];
+        int             i;
+
+        // wake up all monsters in this sector
+        if (sec->validcount == validcount && sec->soundtraversed <= flood.soundblocks + 1)
+            continue;   // already flooded
+
+        sec->validcount = validcount;
+        sec->soundtraversed = flood.soundblocks + 1;
+        sec->soundtarget = target;
+
+        for (i = firstsoundneighbour[flood.sector]; i < firstsoundneighbour[flood.sector + 1]; i++)
+        {
+            soundneighbour_t    *neighbour = &soundneighbours[i];
+            sector_t            *other;
+            int                 soundblocks;
+
+            if (!soundlineopen[neighbour->line])
+                continue;       // closed door
+
+            if (!neighbour->soundblock)
+                soundblocks = flood.soundblocks;
+            else if (!flood.soundblocks)
+                soundblocks = 1;
+            else
+                continue;
+
+            other = &sectors[neighbour->sector];
+            if (other->validcount == validcount && other->soundtraversed <= soundblocks + 1)
+                continue;       // already flooded
+
+            soundfloodstack[count].sector = neighbour->sector;
+            soundfloodstack[count++].soundblocks = soundblocks;
+        }
+    }
 }
 
 //
@@ -1199,7 +1321,7 @@ void A_VileChase(mobj_t *actor)
                 // Call PIT_VileCheck to check
                 // whether object is a corpse
                 // that can be raised.
-                if (!P_BlockThingsIterator(bx, by, PIT_VileCheck))
+                if (!P_BlockThingsIterator(bx, by, PIT_VileCheck, BCF_CORPSE))
                 {
                     // got one!
                     mobj_t     *temp = actor->target;
@@ -1218,6 +1340,7 @@ void A_VileChase(mobj_t *actor)
                     corpsehit->height = info->height;
                     corpsehit->radius = info->radius;
                     corpsehit->flags = info->flags;
+                    P_SetThingBlockClass(corpsehit);
                     corpsehit->flags2 = info->flags2;
                     corpsehit->health = info->spawnhealth;
                     corpsehit->target = NULL;
@@ -752,6 +752,7 @@ void P_KillMobj(mobj_t *source, mobj_t *target)
         target->flags &= ~MF_NOGRAVITY;
 
     target->flags |= (MF_CORPSE | MF_DROPOFF);
+    P_SetThingBlockClass(target);
     target->height >>= 2;
     if (type != MT_BARREL)
     {
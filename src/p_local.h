@@ -45,9 +45,13 @@
 
 // mapblocks are used to check movement
 // against lines and things
-#define MAPBLOCKUNITS           128
+// blockmapshift is 7 for the WAD's 128-unit blocks, or less if the
+// blockmap was rebuilt with blockmap_size set smaller
+extern int              blockmapshift;
+
+#define MAPBLOCKUNITS           (1 << blockmapshift)
 #define MAPBLOCKSIZE            (MAPBLOCKUNITS * FRACUNIT)
-#define MAPBLOCKSHIFT           (FRACBITS + 7)
+#define MAPBLOCKSHIFT           (FRACBITS + blockmapshift)
 #define MAPBMASK                (MAPBLOCKSIZE - 1)
 #define MAPBTOFRAC              (MAPBLOCKSHIFT - FRACBITS)
 
@@ -89,6 +93,8 @@ void P_InitThinkers(void);
 void P_AddThinker(thinker_t *thinker);
 void P_RemoveThinker(thinker_t *thinker);
 
+void P_InitTicHash(void);
+
 //
 // P_PSPR
 //
@@ -146,6 +152,9 @@ void P_SpawnPlayerMissile(mobj_t *source, mobjtype_t type);
 // P_ENEMY
 //
 void P_NoiseAlert(mobj_t *target, mobj_t *emmiter);
+void P_InitSoundNeighbours(void);
+void P_UpdateSoundOpenings(sector_t *sector);
+void P_UpdateAllSoundOpenings(void);
 
 //
 // P_MAPUTL
@@ -185,8 +194,27 @@ extern fixed_t          lowfloor;
 
 void P_LineOpening(line_t *linedef);
 
+// Things in each mapblock are kept in a separate list for each of these
+// classes, so P_BlockThingsIterator only walks the things it's asked for.
+typedef enum
+{
+    BC_CORPSE,
+    BC_SHOOTABLE,
+    BC_SOLID,
+    BC_PICKUP,
+    BC_DECORATION,
+    NUMBLOCKCLASSES
+} blockclass_t;
+
+#define BCF_CORPSE      (1 << BC_CORPSE)
+#define BCF_SHOOTABLE   (1 << BC_SHOOTABLE)
+#define BCF_SOLID       (1 << BC_SOLID)
+#define BCF_PICKUP      (1 << BC_PICKUP)
+#define BCF_DECORATION  (1 << BC_DECORATION)
+#define BCF_ALL         ((1 << NUMBLOCKCLASSES) - 1)
+
 boolean P_BlockLinesIterator(int x, int y, boolean(*func)(line_t *));
-boolean P_BlockThingsIterator(int x, int y, boolean(*func)(mobj_t *));
+boolean P_BlockThingsIterator(int x, int y, boolean(*func)(mobj_t *), int classes);
 
 #define PT_ADDLINES     1
 #define PT_ADDTHINGS    2
@@ -197,8 +225,14 @@ extern divline_t        trace;
 boolean P_PathTraverse(fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2, int flags,
                        boolean (*trav)(intercept_t *));
 
+void P_StartHitscanBatch(mobj_t *source);
+void P_EndHitscanBatch(void);
+
+extern int              blocklinkchanges;
+
 void P_UnsetThingPosition(mobj_t *thing);
 void P_SetThingPosition(mobj_t *thing);
+void P_SetThingBlockClass(mobj_t *thing);
 
 //
 // P_MAP
@@ -224,6 +258,10 @@ boolean P_CheckLineSide(mobj_t *actor, fixed_t x, fixed_t y);
 boolean P_TeleportMove(mobj_t *thing, fixed_t x, fixed_t y, fixed_t z, boolean boss);
 void P_SlideMove(mobj_t *mo);
 boolean P_CheckSight(mobj_t *t1, mobj_t *t2);
+void P_InitSightCache(void);
+void P_ReportSightCache(void);
+void P_ClearSightCache(void);
+void P_SectorMovedSightCache(sector_t *sector);
 void P_UseLines(player_t *player);
 
 boolean P_ChangeSector(sector_t *sector, boolean crunch);
@@ -253,7 +291,7 @@ extern int              bmapwidth;
 extern int              bmapheight;     // in mapblocks
 extern fixed_t          bmaporgx;
 extern fixed_t          bmaporgy;       // origin of block map
-extern mobj_t           **blocklinks;   // for thing chains
+extern mobj_t           **blocklinks;   // for thing chains, NUMBLOCKCLASSES per block
 
 //
 // P_INTER
@@ -24,6 +24,7 @@
 */
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "doomstat.h"
 #include "i_system.h"
@@ -175,7 +176,7 @@ boolean P_TeleportMove(mobj_t *thing, fixed_t x, fixed_t y, fixed_t z, boolean b
 
     for (bx = xl; bx <= xh; bx++)
         for (by = yl; by <= yh; by++)
-            if (!P_BlockThingsIterator(bx, by, PIT_StompThing))
+            if (!P_BlockThingsIterator(bx, by, PIT_StompThing, BCF_CORPSE | BCF_SHOOTABLE))
                 return false;
 
     // the move is ok,
@@ -524,7 +525,8 @@ boolean P_CheckPosition(mobj_t *thing, fixed_t x, fixed_t y)
 
     for (bx = xl; bx <= xh; bx++)
         for (by = yl; by <= yh; by++)
-            if (!P_BlockThingsIterator(bx, by, PIT_CheckThing))
+            if (!P_BlockThingsIterator(bx, by, PIT_CheckThing,
+                BCF_SHOOTABLE | BCF_SOLID | BCF_PICKUP))
                 return false;
 
     // check lines
@@ -593,7 +595,7 @@ mobj_t *P_CheckOnmobj(mobj_t * thing)
 
     for (bx = xl; bx <= xh; bx++)
         for (by = yl; by <= yh; by++)
-            if (!P_BlockThingsIterator(bx, by, PIT_CheckOnmobjZ))
+            if (!P_BlockThingsIterator(bx, by, PIT_CheckOnmobjZ, BCF_ALL & ~BCF_DECORATION))
             {
                 *tmthing = oldmo;
                 return onmobj;
@@ -1652,7 +1654,7 @@ void P_RadiusAttack(mobj_t *spot, mobj_t *source, int damage)
 
     for (y = yl; y <= yh; y++)
         for (x = xl; x <= xh; x++)
-            P_BlockThingsIterator(x, y, PIT_RadiusAttack);
+            P_BlockThingsIterator(x, y, PIT_RadiusAttack, BCF_CORPSE | BCF_SHOOTABLE);
 }
 
 //
@@ -1671,6 +1673,19 @@ void P_RadiusAttack(mobj_t *spot, mobj_t *source, int damage)
 static boolean crushchange;
 static boolean nofit;
 
+// How far past a thing's bbox P_CreateSecNodeList() looks for lines, so the
+// sector list can be kept as is while the thing moves around in open space.
+#define SECNODEMARGIN   (32 * FRACUNIT)
+
+static fixed_t          secnodebbox[4];
+static boolean          secnodeclear;
+
+// The things touching each sector being changed, stacked in case changing
+// one sector changes another.
+static mobj_t           **changesectorthings;
+static int              numchangesectorthings;
+static int              maxchangesectorthings;
+
 void (*P_BloodSplatSpawner)(fixed_t, fixed_t, int, void (*)(void));
 
 //
@@ -1782,40 +1797,48 @@ static void P_UpdateBloodSplat(mobj_t *splat)
 boolean P_ChangeSector(sector_t *sector, boolean crunch)
 {
     msecnode_t  *n;
+    int         first;
+    int         i;
 
     nofit = false;
     crushchange = crunch;
 
-    // killough 4/4/98: scan list front-to-back until empty or exhausted,
-    // restarting from beginning after each thing is processed. Avoids
-    // crashes, and is sure to examine all things in the sector, and only
-    // the things which are in the sector, until a steady-state is reached.
-    // Things can arbitrarily be inserted and removed and it won't mess up.
-    //
-    // killough 4/7/98: simplified to avoid using complicated counter
+    P_UpdateSoundOpenings(sector);
+    P_SectorMovedSightCache(sector);
 
-    // Mark all things invalid
-    for (n = sector->touching_thinglist; n; n = n->m_snext)
-        n->visited = false;
+    // Take a copy of the things touching the sector first, so that sector
+    // nodes can be linked and unlinked while they're processed without the
+    // list having to be scanned again. Things removed along the way are
+    // skipped, and things spawned along the way, such as blood, already
+    // have the new heights.
+    first = numchangesectorthings;
 
-    do
+    for (n = sector->touching_thinglist; n; n = n->m_snext)
     {
-        for (n = sector->touching_thinglist; n; n = n->m_snext) // go through list
+        if (numchangesectorthings == maxchangesectorthings)
         {
-            if (!n->visited)                                    // unprocessed thing found
-            {
-                mobj_t  *mobj = n->m_thing;
-
-                n->visited = true;                              // mark thing as processed
-                if (mobj->type == MT_BLOODSPLAT)
-                    P_UpdateBloodSplat(mobj);
-                else if (!(mobj->flags & MF_NOBLOCKMAP))        // jff 4/7/98 don't do these
-                    PIT_ChangeSector(mobj);                     // process it
-                break;                                          // exit and start over
-            }
+            maxchangesectorthings = (maxchangesectorthings ? maxchangesectorthings * 2 : 256);
+            if (!(changesectorthings = realloc(changesectorthings,
+                maxchangesectorthings * sizeof(*changesectorthings))))
+                I_Error("P_ChangeSector: Failure trying to allocate %i things",
+                    maxchangesectorthings);
         }
+        changesectorthings[numchangesectorthings++] = n->m_thing;
     }
-    while (n);  // repeat from scratch until all things left are marked valid
+
+    for (i = first; i < numchangesectorthings; i++)
+    {
+        mobj_t  *mobj = changesectorthings[i];
+
+        if (mobj->thinker.function.acv == (actionf_v)(-1))
+            continue;                                           // removed
+        if (mobj->type == MT_BLOODSPLAT)
+            P_UpdateBloodSplat(mobj);
+        else if (!(mobj->flags & MF_NOBLOCKMAP))                // jff 4/7/98 don't do these
+            PIT_ChangeSector(mobj);                             // process it
+    }
+
+    numchangesectorthings = first;
 
     return nofit;
 }
@@ -1952,6 +1975,13 @@ void P_DelSeclist(msecnode_t *node)
 // blocking lines.
 static boolean PIT_GetSectors(line_t *ld)
 {
+    if (secnodeclear
+        && secnodebbox[BOXRIGHT] > ld->bbox[BOXLEFT]
+        && secnodebbox[BOXLEFT] < ld->bbox[BOXRIGHT]
+        && secnodebbox[BOXTOP] > ld->bbox[BOXBOTTOM]
+        && secnodebbox[BOXBOTTOM] < ld->bbox[BOXTOP])
+        secnodeclear = false;
+
     if (tmbbox[BOXRIGHT] <= ld->bbox[BOXLEFT]
         || tmbbox[BOXLEFT] >= ld->bbox[BOXRIGHT]
         || tmbbox[BOXTOP] <= ld->bbox[BOXBOTTOM]
@@ -1982,6 +2012,22 @@ static boolean PIT_GetSectors(line_t *ld)
     return true;
 }
 
+//
+// PIT_CheckSecNodeBox
+// Clears secnodeclear if the line's bbox reaches into secnodebbox.
+//
+static boolean PIT_CheckSecNodeBox(line_t *ld)
+{
+    if (secnodebbox[BOXRIGHT] <= ld->bbox[BOXLEFT]
+        || secnodebbox[BOXLEFT] >= ld->bbox[BOXRIGHT]
+        || secnodebbox[BOXTOP] <= ld->bbox[BOXBOTTOM]
+        || secnodebbox[BOXBOTTOM] >= ld->bbox[BOXTOP])
+        return true;
+
+    secnodeclear = false;
+    return false;
+}
+
 // phares 3/14/98
 //
 // P_CreateSecNodeList alters/creates the sector_list that shows what sectors
@@ -1994,6 +2040,21 @@ void P_CreateSecNodeList(mobj_t *thing, fixed_t x, fixed_t y)
     msecnode_t  *node;
     mobj_t      *saved_tmthing = tmthing;
     fixed_t     saved_tmx = tmx, saved_tmy = tmy;
+    fixed_t     *box = thing->secnodebox;
+    fixed_t     radius = thing->radius;
+
+    // If the thing was wholly inside one sector last time and its new
+    // bbox is still within the area around that position that no line's
+    // bbox reaches, the rebuild below can only come up with the same single
+    // node, so keep it as it is.
+    if ((node = thing->old_sectorlist) && !node->m_tnext
+        && node->m_sector == thing->subsector->sector
+        && x - radius >= box[BOXLEFT] && x + radius <= box[BOXRIGHT]
+        && y - radius >= box[BOXBOTTOM] && y + radius <= box[BOXTOP])
+    {
+        sector_list = node;
+        return;
+    }
 
     // First, clear out the existing m_thing fields. As each node is
     // added or verified as needed, m_thing will be set properly. When
@@ -2022,6 +2083,12 @@ void P_CreateSecNodeList(mobj_t *thing, fixed_t x, fixed_t y)
 
     sector_list = thing->old_sectorlist;
 
+    secnodebbox[BOXTOP] = tmbbox[BOXTOP] + SECNODEMARGIN;
+    secnodebbox[BOXBOTTOM] = tmbbox[BOXBOTTOM] - SECNODEMARGIN;
+    secnodebbox[BOXRIGHT] = tmbbox[BOXRIGHT] + SECNODEMARGIN;
+    secnodebbox[BOXLEFT] = tmbbox[BOXLEFT] - SECNODEMARGIN;
+    secnodeclear = true;
+
     for (bx = xl; bx <= xh; bx++)
         for (by = yl; by <= yh; by++)
             P_BlockLinesIterator(bx, by, PIT_GetSectors);
@@ -2029,6 +2096,29 @@ void P_CreateSecNodeList(mobj_t *thing, fixed_t x, fixed_t y)
     // Add the sector of the (x,y) point to sector_list.
     sector_list = P_AddSecnode(thing->subsector->sector, thing, sector_list);
 
+    // If nothing came near, check the blocks around the margin too, and
+    // remember the area for next time if they're clear as well.
+    if (secnodeclear && !sector_list->m_tnext)
+    {
+        int sxl = (secnodebbox[BOXLEFT] - bmaporgx) >> MAPBLOCKSHIFT;
+        int sxh = (secnodebbox[BOXRIGHT] - bmaporgx) >> MAPBLOCKSHIFT;
+        int syl = (secnodebbox[BOXBOTTOM] - bmaporgy) >> MAPBLOCKSHIFT;
+        int syh = (secnodebbox[BOXTOP] - bmaporgy) >> MAPBLOCKSHIFT;
+
+        for (bx = sxl; bx <= sxh && secnodeclear; bx++)
+            for (by = syl; by <= syh && secnodeclear; by++)
+                if (bx < xl || bx > xh || by < yl || by > yh)
+                    P_BlockLinesIterator(bx, by, PIT_CheckSecNodeBox);
+    }
+
+    if (secnodeclear && !sector_list->m_tnext)
+        memcpy(box, secnodebbox, sizeof(secnodebbox));
+    else
+    {
+        box[BOXLEFT] = box[BOXBOTTOM] = INT_MAX;
+        box[BOXRIGHT] = box[BOXTOP] = INT_MIN;
+    }
+
     // Now delete any nodes that won't be used. These are the ones where
     // m_thing is still NULL.
     for (node = sector_list; node;)
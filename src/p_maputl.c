@@ -24,6 +24,9 @@
 */
 
 #include <stdlib.h>
+#include <string.h>
+
+#include "i_system.h"
 #include "m_bbox.h"
 #include "p_local.h"
 
@@ -174,6 +177,29 @@ void P_LineOpening(line_t *linedef)
 // THING POSITION SETTING
 //
 
+// Incremented whenever a thing is linked into or unlinked from the blockmap.
+int     blocklinkchanges;
+
+// The order things are linked into the blockmap in.
+static uint64_t blockorder;
+
+//
+// P_BlockClass
+// Returns which of a block's lists a thing with the given flags belongs in.
+//
+static int P_BlockClass(int flags)
+{
+    if (flags & MF_CORPSE)
+        return BC_CORPSE;
+    if (flags & MF_SHOOTABLE)
+        return BC_SHOOTABLE;
+    if (flags & MF_SOLID)
+        return BC_SOLID;
+    if (flags & MF_SPECIAL)
+        return BC_PICKUP;
+    return BC_DECORATION;
+}
+
 //
 // P_UnsetThingPosition
 // Unlinks a thing from block map and sectors.
@@ -215,6 +241,8 @@ void P_UnsetThingPosition(mobj_t *thing)
     {
         // inert things don't need to be in blockmap
         // unlink from block map
+        blocklinkchanges++;
+
         if (thing->bnext)
             thing->bnext->bprev = thing->bprev;
 
@@ -226,7 +254,8 @@ void P_UnsetThingPosition(mobj_t *thing)
             int blocky = (thing->y - bmaporgy) >> MAPBLOCKSHIFT;
 
             if (blockx >= 0 && blockx < bmapwidth && blocky >= 0 && blocky < bmapheight)
-                blocklinks[blocky * bmapwidth + blockx] = thing->bnext;
+                blocklinks[(blocky * bmapwidth + blockx) * NUMBLOCKCLASSES + thing->blockclass] =
+                    thing->bnext;
         }
     }
 }
@@ -282,9 +311,15 @@ void P_SetThingPosition(mobj_t *thing)
         int     blockx = (thing->x - bmaporgx) >> MAPBLOCKSHIFT;
         int     blocky = (thing->y - bmaporgy) >> MAPBLOCKSHIFT;
 
+        thing->blockclass = P_BlockClass(thing->flags);
+        thing->blockorder = ++blockorder;
+
         if (blockx >= 0 && blockx < bmapwidth && blocky >= 0 && blocky < bmapheight)
         {
-            mobj_t      **link = &blocklinks[blocky * bmapwidth + blockx];
+            mobj_t      **link = &blocklinks[(blocky * bmapwidth + blockx) * NUMBLOCKCLASSES
+                            + thing->blockclass];
+
+            blocklinkchanges++;
 
             thing->bprev = NULL;
             thing->bnext = *link;
@@ -301,6 +336,61 @@ void P_SetThingPosition(mobj_t *thing)
     }
 }
 
+//
+// P_SetThingBlockClass
+// Moves a thing to another of its block's lists after its flags have
+// changed, keeping the order it was linked in.
+//
+void P_SetThingBlockClass(mobj_t *thing)
+{
+    int         blockclass = P_BlockClass(thing->flags);
+    int         blockx, blocky;
+    mobj_t      **link;
+
+    if ((thing->flags & MF_NOBLOCKMAP) || blockclass == thing->blockclass)
+        return;
+
+    blockx = (thing->x - bmaporgx) >> MAPBLOCKSHIFT;
+    blocky = (thing->y - bmaporgy) >> MAPBLOCKSHIFT;
+
+    if (blockx < 0 || blockx >= bmapwidth || blocky < 0 || blocky >= bmapheight)
+    {
+        // thing is off the map
+        thing->blockclass = blockclass;
+        return;
+    }
+
+    link = &blocklinks[(blocky * bmapwidth + blockx) * NUMBLOCKCLASSES];
+
+    // unlink from the old list
+    if (thing->bnext)
+        thing->bnext->bprev = thing->bprev;
+
+    if (thing->bprev)
+        thing->bprev->bnext = thing->bnext;
+    else
+        link[thing->blockclass] = thing->bnext;
+
+    // link into the new one, after any things linked since
+    thing->blockclass = blockclass;
+    thing->bprev = NULL;
+    thing->bnext = link[blockclass];
+
+    while (thing->bnext && thing->bnext->blockorder > thing->blockorder)
+    {
+        thing->bprev = thing->bnext;
+        thing->bnext = thing->bnext->bnext;
+    }
+
+    if (thing->bnext)
+        thing->bnext->bprev = thing;
+
+    if (thing->bprev)
+        thing->bprev->bnext = thing;
+    else
+        link[blockclass] = thing;
+}
+
 //
 // BLOCK MAP ITERATORS
 // For each line/thing in the given mapblock,
@@ -344,17 +434,74 @@ boolean P_BlockLinesIterator(int x, int y, boolean (*func)(line_t *))
 
 //
 // P_BlockThingsIterator
+// Only the things in the given classes are walked, in the order
+// they were linked into the block.
 //
-boolean P_BlockThingsIterator(int x, int y, boolean (*func)(mobj_t *))
+boolean P_BlockThingsIterator(int x, int y, boolean (*func)(mobj_t *), int classes)
 {
-    mobj_t      *mobj;
+    mobj_t      **link;
+    mobj_t      *next[NUMBLOCKCLASSES];
+    int         numlists = 0;
+    int         i;
 
     if (x < 0 || y < 0 || x >= bmapwidth || y >= bmapheight)
         return true;
 
-    for (mobj = blocklinks[y * bmapwidth + x]; mobj; mobj = mobj->bnext)
+    link = &blocklinks[(y * bmapwidth + x) * NUMBLOCKCLASSES];
+
+    for (i = 0; i < NUMBLOCKCLASSES; i++)
+        if ((classes & (1 << i)) && link[i])
+            next[numlists++] = link[i];
+
+    if (numlists == 1)
+    {
+        mobj_t  *mobj = next[0];
+
+        while (mobj)
+        {
+            // func may move the thing to another list
+            int         blockclass = mobj->blockclass;
+            mobj_t      *bnext = mobj->bnext;
+
+            if (!func(mobj))
+                return false;
+
+            if (mobj->blockclass == blockclass)
+                bnext = mobj->bnext;
+            mobj = bnext;
+        }
+        return true;
+    }
+
+    while (numlists)
+    {
+        mobj_t  *mobj = next[0];
+        int     list = 0;
+        int     blockclass;
+        mobj_t  *bnext;
+
+        for (i = 1; i < numlists; i++)
+            if (next[i]->blockorder > mobj->blockorder)
+            {
+                mobj = next[i];
+                list = i;
+            }
+
+        // func may move the thing to another list
+        blockclass = mobj->blockclass;
+        bnext = mobj->bnext;
+
         if (!func(mobj))
             return false;
+
+        if (mobj->blockclass == blockclass)
+            bnext = mobj->bnext;
+
+        if (bnext)
+            next[list] = bnext;
+        else
+            next[list] = next[--numlists];
+    }
     return true;
 }
 
@@ -439,82 +586,103 @@ boolean PIT_AddLineIntercepts(line_t *ld)
 }
 
 //
-// PIT_AddThingIntercepts
+// P_GetThingSide
+// Returns a side of the thing's bounding box as a divline.
 //
-boolean PIT_AddThingIntercepts(mobj_t *thing)
+static void P_GetThingSide(mobj_t *thing, int side, divline_t *line)
 {
-    // Taken from ZDoom:
-    // [RH] Don't check a corner to corner crossection for hit.
-    // Instead, check against the actual bounding box.
+    switch (side)
+    {
+        case 0:     // Top edge
+            line->x = thing->x + thing->radius;
+            line->y = thing->y + thing->radius;
+            line->dx = -thing->radius * 2;
+            line->dy = 0;
+            break;
 
-    // There's probably a smarter way to determine which two sides
-    // of the thing face the trace than by trying all four sides...
-    int         numfronts = 0;
-    divline_t   line;
-    int         i;
+        case 1:     // Right edge
+            line->x = thing->x + thing->radius;
+            line->y = thing->y - thing->radius;
+            line->dx = 0;
+            line->dy = thing->radius * 2;
+            break;
+
+        case 2:     // Bottom edge
+            line->x = thing->x - thing->radius;
+            line->y = thing->y - thing->radius;
+            line->dx = thing->radius * 2;
+            line->dy = 0;
+            break;
+
+        case 3:     // Left edge
+            line->x = thing->x - thing->radius;
+            line->y = thing->y + thing->radius;
+            line->dx = 0;
+            line->dy = thing->radius * -2;
+            break;
+    }
+}
+
+//
+// P_ThingSidesFacingTrace
+// Returns a bitmask of the sides of the thing's bounding box
+// that face the trace origin.
+//
+static int P_ThingSidesFacingTrace(mobj_t *thing)
+{
+    int facing = 0;
+    int i;
 
     for (i = 0; i < 4; ++i)
     {
-        switch (i)
-        {
-            case 0:     // Top edge
-                line.x = thing->x + thing->radius;
-                line.y = thing->y + thing->radius;
-                line.dx = -thing->radius * 2;
-                line.dy = 0;
-                break;
+        divline_t       line;
 
-            case 1:     // Right edge
-                line.x = thing->x + thing->radius;
-                line.y = thing->y - thing->radius;
-                line.dx = 0;
-                line.dy = thing->radius * 2;
-                break;
+        P_GetThingSide(thing, i, &line);
+        if (P_PointOnDivlineSide(trace.x, trace.y, &line) == 0)
+            facing |= (1 << i);
+    }
+    return facing;
+}
 
-            case 2:     // Bottom edge
-                line.x = thing->x - thing->radius;
-                line.y = thing->y - thing->radius;
-                line.dx = thing->radius * 2;
-                line.dy = 0;
-                break;
+static void P_AddThingIntercept(mobj_t *thing, int facing)
+{
+    // Taken from ZDoom:
+    // [RH] Don't check a corner to corner crossection for hit.
+    // Instead, check against the actual bounding box.
+    int i;
 
-            case 3:     // Left edge
-                line.x = thing->x - thing->radius;
-                line.y = thing->y + thing->radius;
-                line.dx = 0;
-                line.dy = thing->radius * -2;
-                break;
-        }
+    for (i = 0; i < 4; ++i)
+    {
+        divline_t       line;
 
         // Check if this side is facing the trace origin
-        if (P_PointOnDivlineSide(trace.x, trace.y, &line) == 0)
-        {
-            numfronts++;
+        if (!(facing & (1 << i)))
+            continue;
 
-            // If it is, see if the trace crosses it
-            if (P_PointOnDivlineSide(line.x, line.y, &trace) !=
-                P_PointOnDivlineSide(line.x + line.dx, line.y + line.dy, &trace))
-            {
-                // It's a hit
-                fixed_t frac = P_InterceptVector(&trace, &line);
+        // If it is, see if the trace crosses it
+        P_GetThingSide(thing, i, &line);
+        if (P_PointOnDivlineSide(line.x, line.y, &trace) !=
+            P_PointOnDivlineSide(line.x + line.dx, line.y + line.dy, &trace))
+        {
+            // It's a hit
+            fixed_t frac = P_InterceptVector(&trace, &line);
 
-                if (frac < 0)
-                    return true;        // behind source
+            if (frac < 0)
+                return;         // behind source
 
-                check_intercept();
+            check_intercept();
 
-                intercept_p->frac = frac;
-                intercept_p->isaline = false;
-                intercept_p->d.thing = thing;
-                intercept_p++;
-                return true;
-            }
+            intercept_p->frac = frac;
+            intercept_p->isaline = false;
+            intercept_p->d.thing = thing;
+            intercept_p++;
+            return;
         }
     }
 
     // If none of the sides were facing the trace, then the trace
     // must have started inside the box, so add it as an intercept.
-    if (numfronts == 0)
+    if (!facing)
     {
         check_intercept();
 
@@ -523,9 +691,156 @@ boolean PIT_AddThingIntercepts(mobj_t *thing)
         intercept_p->d.thing = thing;
         intercept_p++;
     }
+}
+
+//
+// PIT_AddThingIntercepts
+//
+boolean PIT_AddThingIntercepts(mobj_t *thing)
+{
+    P_AddThingIntercept(thing, P_ThingSidesFacingTrace(thing));
     return true;
 }
 
+//
+// HITSCAN BATCHES
+// A_FireShotgun, A_FireShotgun2 and A_BFGSpray fire a fan of hitscans from
+// the same origin. Between P_StartHitscanBatch and P_EndHitscanBatch, the
+// things in each mapblock that such a hitscan passes through are collected
+// once, along with the sides of their bounding boxes that face the origin,
+// and are shared by every later hitscan from that origin that passes through
+// the same mapblock. The collected things are thrown away whenever a thing
+// is linked into or unlinked from the blockmap, so the results are always
+// the same as those of separate hitscans.
+//
+typedef struct
+{
+    mobj_t      *thing;
+    int         facing;
+} batchthing_t;
+
+static boolean          batchactive;
+static fixed_t          batchx;
+static fixed_t          batchy;
+static int              batchstamp;
+static int              batchlinkchanges;
+
+static int              *batchcellstamp;
+static int              *batchcellfirst;
+static int              *batchcellcount;
+static int              num_batchcells;
+
+static batchthing_t     *batchthings;
+static int              numbatchthings;
+static int              maxbatchthings;
+
+void P_StartHitscanBatch(mobj_t *source)
+{
+    int cells = bmapwidth * bmapheight;
+
+    if (!source)
+        return;
+
+    if (cells > num_batchcells)
+    {
+        num_batchcells = cells;
+        if (!(batchcellstamp = (int *)realloc(batchcellstamp, sizeof(*batchcellstamp) * cells))
+            || !(batchcellfirst = (int *)realloc(batchcellfirst, sizeof(*batchcellfirst) * cells))
+            || !(batchcellcount = (int *)realloc(batchcellcount, sizeof(*batchcellcount) * cells)))
+            I_Error("P_StartHitscanBatch: Failure trying to allocate %i mapblocks", cells);
+        memset(batchcellstamp, 0, sizeof(*batchcellstamp) * cells);
+    }
+
+    batchactive = true;
+    batchx = source->x;
+    batchy = source->y;
+    batchstamp++;
+    batchlinkchanges = blocklinkchanges;
+    numbatchthings = 0;
+}
+
+void P_EndHitscanBatch(void)
+{
+    batchactive = false;
+}
+
+static boolean PIT_AddBatchThing(mobj_t *thing)
+{
+    if (numbatchthings == maxbatchthings)
+    {
+        maxbatchthings = (maxbatchthings ? maxbatchthings * 2 : 128);
+        if (!(batchthings = (batchthing_t *)realloc(batchthings, sizeof(*batchthings) * maxbatchthings)))
+            I_Error("PIT_AddBatchThing: Failure trying to allocate %i things", maxbatchthings);
+    }
+    batchthings[numbatchthings].thing = thing;
+    batchthings[numbatchthings].facing = P_ThingSidesFacingTrace(thing);
+    numbatchthings++;
+    return true;
+}
+
+//
+// P_BatchThingsIterator
+// As P_BlockThingsIterator with PIT_AddThingIntercepts, but using the
+// things collected for the mapblock during the current hitscan batch.
+//
+static void P_BatchThingsIterator(int x, int y)
+{
+    int         cell;
+    int         i;
+
+    if (x < 0 || y < 0 || x >= bmapwidth || y >= bmapheight)
+        return;
+
+    cell = y * bmapwidth + x;
+
+    if (batchcellstamp[cell] != batchstamp)
+    {
+        batchcellstamp[cell] = batchstamp;
+        batchcellfirst[cell] = numbatchthings;
+        P_BlockThingsIterator(x, y, PIT_AddBatchThing, BCF_ALL);
+        batchcellcount[cell] = numbatchthings - batchcellfirst[cell];
+    }
+
+    for (i = batchcellfirst[cell]; i < batchcellfirst[cell] + batchcellcount[cell]; i++)
+        P_AddThingIntercept(batchthings[i].thing, batchthings[i].facing);
+}
+
+//
+// Intercept heap
+// The intercepts are traversed through a min-heap of their indexes, ordered
+// by frac and then by index, so intercepts at the same distance are still
+// traversed in the order they were added. Intercepts beyond maxfrac are left
+// out of the heap, and the traversal stops as soon as the traverser function
+// returns false.
+//
+static int      *interceptheap;
+
+static boolean P_InterceptBefore(int a, int b)
+{
+    return (intercepts[a].frac < intercepts[b].frac
+        || (intercepts[a].frac == intercepts[b].frac && a < b));
+}
+
+static void P_SiftDownIntercept(int i, int count)
+{
+    int index = interceptheap[i];
+
+    while (1)
+    {
+        int child = i * 2 + 1;
+
+        if (child >= count)
+            break;
+        if (child + 1 < count && P_InterceptBefore(interceptheap[child + 1], interceptheap[child]))
+            child++;
+        if (!P_InterceptBefore(interceptheap[child], index))
+            break;
+        interceptheap[i] = interceptheap[child];
+        i = child;
+    }
+    interceptheap[i] = index;
+}
+
 //
 // P_TraverseIntercepts
 // Returns true if the traverser function returns true
@@ -533,30 +848,33 @@ boolean PIT_AddThingIntercepts(mobj_t *thing)
 //
 boolean P_TraverseIntercepts(traverser_t func, fixed_t maxfrac)
 {
+    static int  num_interceptheap;
     int         count = intercept_p - intercepts;
-    intercept_t *in = NULL;
+    int         i;
 
-    while (count--)
+    if (count > num_interceptheap)
     {
-        fixed_t     dist = INT_MAX;
-        intercept_t *scan;
+        num_interceptheap = count * 2;
+        if (!(interceptheap = (int *)realloc(interceptheap, sizeof(*interceptheap) * num_interceptheap)))
+            I_Error("P_TraverseIntercepts: Failure trying to allocate %i intercepts", num_interceptheap);
+    }
 
-        for (scan = intercepts; scan < intercept_p; scan++)
-        {
-            if (scan->frac < dist)
-            {
-                dist = scan->frac;
-                in = scan;
-            }
-        }
+    for (i = 0, count = 0; intercepts + i < intercept_p; i++)
+        if (intercepts[i].frac <= maxfrac)
+            interceptheap[count++] = i;
 
-        if (dist > maxfrac)
-            return true;        // checked everything in range
+    for (i = count / 2 - 1; i >= 0; i--)
+        P_SiftDownIntercept(i, count);
+
+    while (count)
+    {
+        intercept_t *in = &intercepts[interceptheap[0]];
+
+        interceptheap[0] = interceptheap[--count];
+        P_SiftDownIntercept(0, count);
 
         if (!func(in))
             return false;       // don't bother going farther
-
-        in->frac = INT_MAX;
     }
 
     return true;                // everything was traversed
@@ -580,9 +898,18 @@ boolean P_PathTraverse(fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2,
     int         mapx, mapy;
     int         mapxstep, mapystep;
     int         count;
+    boolean     batch = (batchactive && x1 == batchx && y1 == batchy);
 
     earlyout = (flags & PT_EARLYOUT);
 
+    if (batch && batchlinkchanges != blocklinkchanges)
+    {
+        // things have moved since they were collected
+        batchstamp++;
+        batchlinkchanges = blocklinkchanges;
+        numbatchthings = 0;
+    }
+
     validcount++;
     intercept_p = intercepts;
 
@@ -662,8 +989,12 @@ boolean P_PathTraverse(fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2,
                 return false;           // early out
 
         if (flags & PT_ADDTHINGS)
-            if (!P_BlockThingsIterator(mapx, mapy, PIT_AddThingIntercepts))
+        {
+            if (batch)
+                P_BatchThingsIterator(mapx, mapy);
+            else if (!P_BlockThingsIterator(mapx, mapy, PIT_AddThingIntercepts, BCF_ALL))
                 return false;           // early out
+        }
 
         if (mapx == xt2 && mapy == yt2)
             break;
@@ -695,10 +1026,20 @@ boolean P_PathTraverse(fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2,
 
                 if (flags & PT_ADDTHINGS)
                 {
-                    if (!P_BlockThingsIterator(mapx + mapxstep, mapy, PIT_AddThingIntercepts))
-                        return false;
-                    if (!P_BlockThingsIterator(mapx, mapy + mapystep, PIT_AddThingIntercepts))
-                        return false;
+                    if (batch)
+                    {
+                        P_BatchThingsIterator(mapx + mapxstep, mapy);
+                        P_BatchThingsIterator(mapx, mapy + mapystep);
+                    }
+                    else
+                    {
+                        if (!P_BlockThingsIterator(mapx + mapxstep, mapy, PIT_AddThingIntercepts,
+                            BCF_ALL))
+                            return false;
+                        if (!P_BlockThingsIterator(mapx, mapy + mapystep, PIT_AddThingIntercepts,
+                            BCF_ALL))
+                            return false;
+                    }
                 }
                 xintercept += xstep;
                 yintercept += ystep;
@@ -258,24 +258,34 @@ typedef struct mobj_s
     // List: thinker links.
     thinker_t           thinker;
 
+    // The fields P_MobjThinker(), P_XYMovement(), P_ZMovement() and
+    // R_ProjectSprite() read every tic come first, so they share the first
+    // couple of cache lines. Links, AI and bookkeeping fields follow, with
+    // what's only needed now and then (or only by savegames) at the end.
+
     // Info for drawing: position.
     fixed_t             x;
     fixed_t             y;
     fixed_t             z;
 
-    // More list: links in sector (if needed)
-    struct mobj_s       *snext;
-    struct mobj_s       *sprev;
+    // Momentums, used to update position.
+    fixed_t             momx;
+    fixed_t             momy;
+    fixed_t             momz;
 
     //More drawing info: to determine current sprite.
     angle_t             angle;  // orientation
     spritenum_t         sprite; // used to find patch_t and flip value
     int                 frame;  // might be ORed with FF_FULLBRIGHT
 
-    // Interaction info, by BLOCKMAP.
-    // Links in blocks (if needed).
-    struct mobj_s       *bnext;
-    struct mobj_s       *bprev;
+    int                 flags;
+    int                 flags2;
+
+    int                 tics;   // state tic counter
+    mobjtype_t          type;
+    state_t             *state;
+
+    void                (*colfunc)(void);
 
     struct subsector_s  *subsector;
 
@@ -290,25 +300,32 @@ typedef struct mobj_s
     fixed_t             radius;
     fixed_t             height;
 
-    fixed_t             projectilepassheight;
+    // Additional info record for player avatars only.
+    // Only valid if type == MT_PLAYER
+    struct player_s     *player;
 
-    // Momentums, used to update position.
-    fixed_t             momx;
-    fixed_t             momy;
-    fixed_t             momz;
+    // More list: links in sector (if needed)
+    struct mobj_s       *snext;
+    struct mobj_s       *sprev;
 
-    // If == validcount, already checked.
-    int                 validcount;
+    // Interaction info, by BLOCKMAP.
+    // Links in blocks (if needed).
+    struct mobj_s       *bnext;
+    struct mobj_s       *bprev;
 
-    mobjtype_t          type;
-    mobjinfo_t          *info;  // &mobjinfo[mobj->type]
+    // Which of the block's lists the links are in, and the order
+    // the thing was linked in, to walk several lists in that order.
+    int                 blockclass;
+    uint64_t            blockorder;
 
-    int                 tics;   // state tic counter
-    state_t             *state;
-    int                 flags;
-    int                 flags2;
+    mobjinfo_t          *info;  // &mobjinfo[mobj->type]
     int                 health;
 
+    // If == validcount, already checked.
+    int                 validcount;
+
+    fixed_t             projectilepassheight;
+
     // Movement direction, movement generation (zig-zagging).
     int                 movedir;        // 0-7
     int                 movecount;      // when 0, select a new dir
@@ -325,15 +342,11 @@ typedef struct mobj_s
     // no matter what (even if shot)
     int                 threshold;
 
-    // Additional info record for player avatars only.
-    // Only valid if type == MT_PLAYER
-    struct player_s     *player;
-
     // Player number last looked for.
     int                 lastlook;
 
-    // For nightmare respawn.
-    mapthing_t          spawnpoint;
+    // For bobbing up and down.
+    int                 floatbob;
 
     // Thing being chased/attacked for tracers.
     struct mobj_s       *tracer;
@@ -341,18 +354,19 @@ typedef struct mobj_s
     // new field: last known enemy -- killough 2/15/98
     struct mobj_s       *lastenemy;
 
-    // For bobbing up and down.
-    int                 floatbob;
-
-    void                (*colfunc)(void);
-
     // a linked list of sectors where this object appears
     struct msecnode_s   *touching_sectorlist;   // phares 3/14/98
     struct msecnode_s   *old_sectorlist;        // haleyjd 04/16/10
 
+    // area around the last sector list rebuild that no line's bbox reaches
+    fixed_t             secnodebox[4];
+
     short               gear; // killough 11/98: used in torque simulation
 
     int                 bloodsplats;
+
+    // For nightmare respawn.
+    mapthing_t          spawnpoint;
 } mobj_t;
 
 #endif
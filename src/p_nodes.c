@@ -0,0 +1,682 @@
+/*
+========================================================================
+
+  DOOM RETRO
+  The classic, refined DOOM source port. For Windows PC.
+  Copyright (C) 2013-2014 Brad Harding.
+
+  This file is part of DOOM RETRO.
+
+  DOOM RETRO is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  DOOM RETRO is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with DOOM RETRO. If not, see <http://www.gnu.org/licenses/>.
+
+========================================================================
+*/
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "i_system.h"
+#include "m_bbox.h"
+#include "p_local.h"
+#include "p_nodes.h"
+
+//
+// NODE BUILDER
+// Used when a map has no nodes. Each level of the tree is split along
+// whichever linedef splits the fewest segs while keeping both sides
+// closest in size. Large seg lists only have a sample of their linedefs
+// tried. A list none of them can split is convex, and becomes a
+// subsector.
+//
+#define SIDE_EPSILON    (1.0 / 256.0)
+#define MAXCANDIDATES   64
+#define SPLITCOST       8
+
+enum
+{
+    SEG_FRONT,
+    SEG_BACK,
+    SEG_SPLIT
+};
+
+typedef struct
+{
+    int                 v1, v2;
+    int                 linedef;
+    int                 side;
+} bspseg_t;
+
+typedef struct
+{
+    short               x, y;
+    short               dx, dy;
+    short               bbox[2][4];
+    unsigned int        children[2];
+} bspnode_t;
+
+typedef struct
+{
+    int                 linedef;
+    int                 side;
+    double              x, y;
+    double              dx, dy;
+    double              length;
+} partition_t;
+
+static fixed_t          *bspvertexx;
+static fixed_t          *bspvertexy;
+static int              numbspvertexes;
+static int              maxbspvertexes;
+
+static bspseg_t         *bspsegs;
+static int              numbspsegs;
+static int              maxbspsegs;
+
+// the segs in subsector order, and how many each subsector has
+static int              *outsegs;
+static int              numoutsegs;
+static int              maxoutsegs;
+static unsigned int     *outsubsectors;
+static int              numoutsubsectors;
+static int              maxoutsubsectors;
+
+static bspnode_t        *outnodes;
+static int              numoutnodes;
+static int              maxoutnodes;
+
+// the linedefs already tried as a partition for the current seg list
+static int              *linestamp;
+static int              stamp;
+
+static int P_AddBSPVertex(fixed_t x, fixed_t y)
+{
+    if (numbspvertexes == maxbspvertexes)
+    {
+        maxbspvertexes = (maxbspvertexes ? maxbspvertexes * 2 : 1024);
+        bspvertexx = (fixed_t *)realloc(bspvertexx, maxbspvertexes * sizeof(*bspvertexx));
+        bspvertexy = (fixed_t *)realloc(bspvertexy, maxbspvertexes * sizeof(*bspvertexy));
+    }
+    bspvertexx[numbspvertexes] = x;
+    bspvertexy[numbspvertexes] = y;
+    return numbspvertexes++;
+}
+
+static int P_AddBSPSeg(int v1, int v2, int linedef, int side)
+{
+    if (numbspsegs == maxbspsegs)
+    {
+        maxbspsegs = (maxbspsegs ? maxbspsegs * 2 : 1024);
+        bspsegs = (bspseg_t *)realloc(bspsegs, maxbspsegs * sizeof(*bspsegs));
+    }
+    bspsegs[numbspsegs].v1 = v1;
+    bspsegs[numbspsegs].v2 = v2;
+    bspsegs[numbspsegs].linedef = linedef;
+    bspsegs[numbspsegs].side = side;
+    return numbspsegs++;
+}
+
+//
+// P_SegPartition
+// Returns the line a seg lies along, pointing the way the seg faces.
+//
+static void P_SegPartition(const bspseg_t *seg, partition_t *part)
+{
+    const line_t        *line = lines + seg->linedef;
+    const vertex_t      *v1 = (seg->side ? line->v2 : line->v1);
+    const vertex_t      *v2 = (seg->side ? line->v1 : line->v2);
+
+    part->linedef = seg->linedef;
+    part->side = seg->side;
+    part->x = v1->x / (double)FRACUNIT;
+    part->y = v1->y / (double)FRACUNIT;
+    part->dx = (v2->x - v1->x) / (double)FRACUNIT;
+    part->dy = (v2->y - v1->y) / (double)FRACUNIT;
+    part->length = sqrt(part->dx * part->dx + part->dy * part->dy);
+}
+
+//
+// P_PartitionDistance
+// Returns how far a vertex is in front of a partition line.
+//
+static double P_PartitionDistance(const partition_t *part, int v)
+{
+    return ((bspvertexx[v] / (double)FRACUNIT - part->x) * part->dy
+        - (bspvertexy[v] / (double)FRACUNIT - part->y) * part->dx) / part->length;
+}
+
+static int P_ClassifySeg(const partition_t *part, const bspseg_t *seg, double *d1, double *d2)
+{
+    *d1 = P_PartitionDistance(part, seg->v1);
+    *d2 = P_PartitionDistance(part, seg->v2);
+
+    if (fabs(*d1) < SIDE_EPSILON && fabs(*d2) < SIDE_EPSILON)
+        // on the partition line, so goes on the side it faces
+        return ((double)(bspvertexx[seg->v2] - bspvertexx[seg->v1]) * part->dx
+            + (double)(bspvertexy[seg->v2] - bspvertexy[seg->v1]) * part->dy > 0.0 ?
+            SEG_FRONT : SEG_BACK);
+
+    if (*d1 > -SIDE_EPSILON && *d2 > -SIDE_EPSILON)
+        return SEG_FRONT;
+
+    if (*d1 < SIDE_EPSILON && *d2 < SIDE_EPSILON)
+        return SEG_BACK;
+
+    return SEG_SPLIT;
+}
+
+//
+// P_EvaluatePartition
+// Returns the cost of splitting a list of segs along a partition line,
+// or -1 if it would leave either side empty.
+//
+static int P_EvaluatePartition(const partition_t *part, const int *segs, int count, int bestcost)
+{
+    int         front = 0;
+    int         back = 0;
+    int         splits = 0;
+    int         i;
+
+    for (i = 0; i < count; i++)
+    {
+        double  d1, d2;
+
+        switch (P_ClassifySeg(part, bspsegs + segs[i], &d1, &d2))
+        {
+            case SEG_FRONT:
+                front++;
+                break;
+
+            case SEG_BACK:
+                back++;
+                break;
+
+            default:
+                front++;
+                back++;
+
+                if (++splits * SPLITCOST >= bestcost && bestcost >= 0)
+                    return INT_MAX;
+                break;
+        }
+    }
+
+    if (!front || !back)
+        return -1;
+
+    return (splits * SPLITCOST + ABS(front - back));
+}
+
+//
+// P_ChoosePartition
+// Returns false if no linedef splits the segs, so they form a subsector.
+//
+static boolean P_ChoosePartition(const int *segs, int count, partition_t *best)
+{
+    int         bestcost = -1;
+    int         step = count / MAXCANDIDATES + 1;
+    int         i;
+
+    while (1)
+    {
+        stamp++;
+
+        for (i = 0; i < count; i += step)
+        {
+            const bspseg_t      *seg = bspsegs + segs[i];
+            partition_t         part;
+            int                 cost;
+
+            if (linestamp[seg->linedef] == stamp)
+                continue;
+            linestamp[seg->linedef] = stamp;
+
+            P_SegPartition(seg, &part);
+            cost = P_EvaluatePartition(&part, segs, count, bestcost);
+
+            if (cost >= 0 && (bestcost < 0 || cost < bestcost))
+            {
+                bestcost = cost;
+                *best = part;
+            }
+        }
+
+        // only when none of the sampled linedefs split the segs is every
+        // one of them tried
+        if (bestcost >= 0 || step == 1)
+            return (bestcost >= 0);
+        step = 1;
+    }
+}
+
+//
+// P_SplitSeg
+// Splits a seg where it crosses a partition line, adding the two halves
+// to the front and back lists.
+//
+static void P_SplitSeg(int segnum, double d1, double d2,
+    int *front, int *numfront, int *back, int *numback)
+{
+    bspseg_t    *seg = bspsegs + segnum;
+    double      frac = d1 / (d1 - d2);
+    fixed_t     x = (fixed_t)floor(bspvertexx[seg->v1]
+                    + frac * ((double)bspvertexx[seg->v2] - bspvertexx[seg->v1]) + 0.5);
+    fixed_t     y = (fixed_t)floor(bspvertexy[seg->v1]
+                    + frac * ((double)bspvertexy[seg->v2] - bspvertexy[seg->v1]) + 0.5);
+    int         v1 = seg->v1;
+    int         v2 = seg->v2;
+    int         v, newseg;
+
+    // too close to either end to split
+    if ((x == bspvertexx[v1] && y == bspvertexy[v1]) || (x == bspvertexx[v2] && y == bspvertexy[v2]))
+    {
+        if (fabs(d1) > fabs(d2) ? d1 > 0.0 : d2 > 0.0)
+            front[(*numfront)++] = segnum;
+        else
+            back[(*numback)++] = segnum;
+        return;
+    }
+
+    v = P_AddBSPVertex(x, y);
+    newseg = P_AddBSPSeg(v, v2, seg->linedef, seg->side);
+    bspsegs[segnum].v2 = v;
+
+    if (d1 > 0.0)
+    {
+        front[(*numfront)++] = segnum;
+        back[(*numback)++] = newseg;
+    }
+    else
+    {
+        back[(*numback)++] = segnum;
+        front[(*numfront)++] = newseg;
+    }
+}
+
+static void P_SetNodeBox(short *nodebox, const fixed_t *bbox)
+{
+    nodebox[BOXTOP] = (short)((bbox[BOXTOP] + FRACUNIT - 1) >> FRACBITS);
+    nodebox[BOXBOTTOM] = (short)(bbox[BOXBOTTOM] >> FRACBITS);
+    nodebox[BOXLEFT] = (short)(bbox[BOXLEFT] >> FRACBITS);
+    nodebox[BOXRIGHT] = (short)((bbox[BOXRIGHT] + FRACUNIT - 1) >> FRACBITS);
+}
+
+//
+// P_AddBSPSubsector
+// Adds a subsector made from a list of segs, which it frees, and returns
+// its child index.
+//
+static unsigned int P_AddBSPSubsector(int *segs, int count)
+{
+    if (numoutsegs + count > maxoutsegs)
+    {
+        maxoutsegs = numbspsegs;
+        outsegs = (int *)realloc(outsegs, maxoutsegs * sizeof(*outsegs));
+    }
+    memcpy(outsegs + numoutsegs, segs, count * sizeof(*segs));
+    numoutsegs += count;
+    free(segs);
+
+    if (numoutsubsectors == maxoutsubsectors)
+    {
+        maxoutsubsectors = (maxoutsubsectors ? maxoutsubsectors * 2 : 1024);
+        outsubsectors = (unsigned int *)realloc(outsubsectors,
+            maxoutsubsectors * sizeof(*outsubsectors));
+    }
+    outsubsectors[numoutsubsectors] = count;
+    return (numoutsubsectors++ | 0x80000000);
+}
+
+//
+// P_BuildBSPNode
+// Builds the subtree for a list of segs, which it frees, and returns its
+// child index. The bounding box of the segs is returned in bbox.
+//
+static unsigned int P_BuildBSPNode(int *segs, int count, fixed_t *bbox)
+{
+    partition_t part;
+    int         *front, *back;
+    int         numfront = 0, numback = 0;
+    fixed_t     frontbox[4], backbox[4];
+    int         i;
+    bspnode_t   *node;
+    unsigned int children[2];
+    const line_t *line;
+    int         x, y, dx, dy;
+
+    M_ClearBox(bbox);
+    for (i = 0; i < count; i++)
+    {
+        M_AddToBox(bbox, bspvertexx[bspsegs[segs[i]].v1], bspvertexy[bspsegs[segs[i]].v1]);
+        M_AddToBox(bbox, bspvertexx[bspsegs[segs[i]].v2], bspvertexy[bspsegs[segs[i]].v2]);
+    }
+
+    if (!P_ChoosePartition(segs, count, &part))
+        return P_AddBSPSubsector(segs, count);
+
+    front = (int *)malloc(count * sizeof(*front));
+    back = (int *)malloc(count * sizeof(*back));
+
+    for (i = 0; i < count; i++)
+    {
+        double  d1, d2;
+
+        switch (P_ClassifySeg(&part, bspsegs + segs[i], &d1, &d2))
+        {
+            case SEG_FRONT:
+                front[numfront++] = segs[i];
+                break;
+
+            case SEG_BACK:
+                back[numback++] = segs[i];
+                break;
+
+            default:
+                P_SplitSeg(segs[i], d1, d2, front, &numfront, back, &numback);
+                break;
+        }
+    }
+    free(segs);
+
+    // segs that were too close to the partition to split can still leave
+    //  one side empty, so they form a subsector instead
+    if (!numfront)
+    {
+        free(front);
+        return P_AddBSPSubsector(back, numback);
+    }
+    else if (!numback)
+    {
+        free(back);
+        return P_AddBSPSubsector(front, numfront);
+    }
+
+    children[0] = P_BuildBSPNode(front, numfront, frontbox);
+    children[1] = P_BuildBSPNode(back, numback, backbox);
+
+    if (numoutnodes == maxoutnodes)
+    {
+        maxoutnodes = (maxoutnodes ? maxoutnodes * 2 : 1024);
+        outnodes = (bspnode_t *)realloc(outnodes, maxoutnodes * sizeof(*outnodes));
+    }
+    node = outnodes + numoutnodes;
+
+    // nodes store the partition as whole map units, so it's taken from the
+    // linedef, halving the direction if it doesn't fit
+    line = lines + part.linedef;
+    x = (part.side ? line->v2 : line->v1)->x >> FRACBITS;
+    y = (part.side ? line->v2 : line->v1)->y >> FRACBITS;
+    dx = ((part.side ? line->v1 : line->v2)->x >> FRACBITS) - x;
+    dy = ((part.side ? line->v1 : line->v2)->y >> FRACBITS) - y;
+
+    while (dx < SHRT_MIN || dx > SHRT_MAX || dy < SHRT_MIN || dy > SHRT_MAX)
+    {
+        dx /= 2;
+        dy /= 2;
+    }
+
+    node->x = (short)x;
+    node->y = (short)y;
+    node->dx = (short)dx;
+    node->dy = (short)dy;
+    P_SetNodeBox(node->bbox[0], frontbox);
+    P_SetNodeBox(node->bbox[1], backbox);
+    node->children[0] = children[0];
+    node->children[1] = children[1];
+
+    return numoutnodes++;
+}
+
+static byte *P_WriteLong(byte *p, unsigned int value)
+{
+    p[0] = (byte)value;
+    p[1] = (byte)(value >> 8);
+    p[2] = (byte)(value >> 16);
+    p[3] = (byte)(value >> 24);
+    return p + 4;
+}
+
+static byte *P_WriteShort(byte *p, unsigned short value)
+{
+    p[0] = (byte)value;
+    p[1] = (byte)(value >> 8);
+    return p + 2;
+}
+
+//
+// P_BuildNodes
+//
+byte *P_BuildNodes(int *length)
+{
+    int         *segs;
+    int         i, j, k;
+    fixed_t     bbox[4];
+    byte        *data, *p;
+
+    numbspvertexes = numbspsegs = numoutsegs = numoutsubsectors = numoutnodes = 0;
+    maxoutsegs = 0;
+
+    for (i = 0; i < numvertexes; i++)
+        P_AddBSPVertex(vertexes[i].x, vertexes[i].y);
+
+    for (i = 0; i < numlines; i++)
+    {
+        const line_t    *line = lines + i;
+        int             v1 = line->v1 - vertexes;
+        int             v2 = line->v2 - vertexes;
+
+        if (line->v1->x == line->v2->x && line->v1->y == line->v2->y)
+            continue;
+
+        if (line->sidenum[0] != NO_INDEX)
+            P_AddBSPSeg(v1, v2, i, 0);
+        if (line->sidenum[1] != NO_INDEX)
+            P_AddBSPSeg(v2, v1, i, 1);
+    }
+
+    if (!numbspsegs)
+        I_Error("P_BuildNodes: no linedefs in level");
+
+    segs = (int *)malloc(numbspsegs * sizeof(*segs));
+    for (i = 0; i < numbspsegs; i++)
+        segs[i] = i;
+
+    linestamp = (int *)calloc(numlines, sizeof(*linestamp));
+    stamp = 0;
+
+    P_BuildBSPNode(segs, numbspsegs, bbox);
+
+    free(linestamp);
+
+    // write it out as an XNOD lump
+    *length = 4 + 8 + (numbspvertexes - numvertexes) * 8 + 4 + numoutsubsectors * 4
+        + 4 + numoutsegs * 11 + 4 + numoutnodes * 32;
+    data = p = (byte *)malloc(*length);
+
+    memcpy(p, "XNOD", 4);
+    p += 4;
+    p = P_WriteLong(p, numvertexes);
+    p = P_WriteLong(p, numbspvertexes - numvertexes);
+
+    for (i = numvertexes; i < numbspvertexes; i++)
+    {
+        p = P_WriteLong(p, bspvertexx[i]);
+        p = P_WriteLong(p, bspvertexy[i]);
+    }
+
+    p = P_WriteLong(p, numoutsubsectors);
+    for (i = 0; i < numoutsubsectors; i++)
+        p = P_WriteLong(p, outsubsectors[i]);
+
+    p = P_WriteLong(p, numoutsegs);
+    for (i = 0; i < numoutsegs; i++)
+    {
+        const bspseg_t  *seg = bspsegs + outsegs[i];
+
+        p = P_WriteLong(p, seg->v1);
+        p = P_WriteLong(p, seg->v2);
+        p = P_WriteShort(p, seg->linedef);
+        *p++ = (byte)seg->side;
+    }
+
+    p = P_WriteLong(p, numoutnodes);
+    for (i = 0; i < numoutnodes; i++)
+    {
+        const bspnode_t *node = outnodes + i;
+
+        p = P_WriteShort(p, node->x);
+        p = P_WriteShort(p, node->y);
+        p = P_WriteShort(p, node->dx);
+        p = P_WriteShort(p, node->dy);
+        for (j = 0; j < 2; j++)
+            for (k = 0; k < 4; k++)
+                p = P_WriteShort(p, node->bbox[j][k]);
+        p = P_WriteLong(p, node->children[0]);
+        p = P_WriteLong(p, node->children[1]);
+    }
+
+    return data;
+}
+
+//
+// BLOCKMAP BUILDER
+// Used when a map has no blockmap. As in the blockmaps node builders
+// write, every block's list starts with a 0, and empty blocks share the
+// same list.
+//
+
+//
+// P_LineCrossesBlock
+//
+static boolean P_LineCrossesBlock(int x1, int y1, int x2, int y2, int bx, int by)
+{
+    int64_t     dx = x2 - x1;
+    int64_t     dy = y2 - y1;
+    int         left = bx << MAPBTOFRAC;
+    int         bottom = by << MAPBTOFRAC;
+    int         right = left + MAPBLOCKUNITS;
+    int         top = bottom + MAPBLOCKUNITS;
+    int64_t     s1, s2, s3, s4;
+
+    if (!dx || !dy)
+        return true;
+
+    s1 = (left - x1) * dy - (bottom - y1) * dx;
+    s2 = (right - x1) * dy - (bottom - y1) * dx;
+    s3 = (left - x1) * dy - (top - y1) * dx;
+    s4 = (right - x1) * dy - (top - y1) * dx;
+
+    return !((s1 > 0 && s2 > 0 && s3 > 0 && s4 > 0) || (s1 < 0 && s2 < 0 && s3 < 0 && s4 < 0));
+}
+
+//
+// P_BuildBlockMap
+//
+uint32_t *P_BuildBlockMap(unsigned int *count)
+{
+    int         minx, miny;
+    int         maxx, maxy;
+    int         orgx, orgy;
+    int         width, height;
+    int         *blockcount;
+    uint32_t    *blockmap;
+    uint32_t    *list;
+    int         i, pass;
+
+    if (!numlines)
+        I_Error("P_BuildBlockMap: no linedefs in level");
+
+    minx = maxx = lines[0].v1->x >> FRACBITS;
+    miny = maxy = lines[0].v1->y >> FRACBITS;
+
+    for (i = 0; i < numlines; i++)
+    {
+        int     x1 = lines[i].v1->x >> FRACBITS;
+        int     y1 = lines[i].v1->y >> FRACBITS;
+        int     x2 = lines[i].v2->x >> FRACBITS;
+        int     y2 = lines[i].v2->y >> FRACBITS;
+
+        minx = MIN(minx, MIN(x1, x2));
+        miny = MIN(miny, MIN(y1, y2));
+        maxx = MAX(maxx, MAX(x1, x2));
+        maxy = MAX(maxy, MAX(y1, y2));
+    }
+
+    orgx = minx - 8;
+    orgy = miny - 8;
+    width = ((maxx - orgx) >> MAPBTOFRAC) + 1;
+    height = ((maxy - orgy) >> MAPBTOFRAC) + 1;
+
+    blockcount = (int *)calloc(width * height, sizeof(*blockcount));
+
+    // count each block's lines first, then fill in their lists
+    for (pass = 0; pass < 2; pass++)
+    {
+        if (pass)
+        {
+            *count = 4 + width * height + 2;
+            for (i = 0; i < width * height; i++)
+                if (blockcount[i])
+                    *count += blockcount[i] + 2;
+
+            blockmap = (uint32_t *)malloc(*count * sizeof(*blockmap));
+            blockmap[0] = orgx;
+            blockmap[1] = orgy;
+            blockmap[2] = width;
+            blockmap[3] = height;
+
+            // the shared empty list
+            list = blockmap + 4 + width * height;
+            list[0] = 0;
+            list[1] = (uint32_t)(-1);
+            list += 2;
+
+            for (i = 0; i < width * height; i++)
+                if (blockcount[i])
+                {
+                    blockmap[4 + i] = list - blockmap;
+                    *list = 0;
+                    list += blockcount[i] + 2;
+                    list[-1] = (uint32_t)(-1);
+                    blockcount[i] = 1;
+                }
+                else
+                    blockmap[4 + i] = 4 + width * height;
+        }
+
+        for (i = 0; i < numlines; i++)
+        {
+            int x1 = (lines[i].v1->x >> FRACBITS) - orgx;
+            int y1 = (lines[i].v1->y >> FRACBITS) - orgy;
+            int x2 = (lines[i].v2->x >> FRACBITS) - orgx;
+            int y2 = (lines[i].v2->y >> FRACBITS) - orgy;
+            int bx, by;
+
+            for (by = MIN(y1, y2) >> MAPBTOFRAC; by <= MAX(y1, y2) >> MAPBTOFRAC; by++)
+                for (bx = MIN(x1, x2) >> MAPBTOFRAC; bx <= MAX(x1, x2) >> MAPBTOFRAC; bx++)
+                    if (P_LineCrossesBlock(x1, y1, x2, y2, bx, by))
+                    {
+                        int block = by * width + bx;
+
+                        if (pass)
+                            blockmap[blockmap[4 + block] + blockcount[block]++] = i;
+                        else
+                            blockcount[block]++;
+                    }
+        }
+    }
+
+    free(blockcount);
+    return blockmap;
+}
@@ -0,0 +1,38 @@
+/*
+========================================================================
+
+  DOOM RETRO
+  The classic, refined DOOM source port. For Windows PC.
+  Copyright (C) 2013-2014 Brad Harding.
+
+  This file is part of DOOM RETRO.
+
+  DOOM RETRO is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  DOOM RETRO is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with DOOM RETRO. If not, see <http://www.gnu.org/licenses/>.
+
+========================================================================
+*/
+
+#ifndef __P_NODES__
+#define __P_NODES__
+
+#include "doomtype.h"
+
+// Builds a BSP tree for the current level's vertexes and linedefs, and
+// returns it as a ZDoom extended nodes (XNOD) lump.
+byte *P_BuildNodes(int *length);
+
+// Builds a blockmap for the current level's linedefs.
+uint32_t *P_BuildBlockMap(unsigned int *count);
+
+#endif
@@ -526,11 +526,15 @@ void A_FireShotgun(player_t *player, pspdef_t *psp)
 
     P_SetPsprite(player, ps_flash, (statenum_t)weaponinfo[player->readyweapon].flashstate);
 
+    P_StartHitscanBatch(player->mo);
+
     P_BulletSlope(player->mo);
 
     for (i = 0; i < 7; i++)
         P_GunShot(player->mo, false);
 
+    P_EndHitscanBatch();
+
     player->preferredshotgun = wp_shotgun;
 }
 
@@ -548,6 +552,8 @@ void A_FireShotgun2(player_t *player, pspdef_t *psp)
 
     P_SetPsprite(player, ps_flash, (statenum_t)weaponinfo[player->readyweapon].flashstate);
 
+    P_StartHitscanBatch(player->mo);
+
     P_BulletSlope(player->mo);
 
     for (i = 0; i < 20; i++)
@@ -559,6 +565,8 @@ void A_FireShotgun2(player_t *player, pspdef_t *psp)
                      bulletslope + ((P_Random() - P_Random()) << 5), damage);
     }
 
+    P_EndHitscanBatch();
+
     player->preferredshotgun = wp_supershotgun;
 }
 
@@ -607,6 +615,8 @@ void A_BFGSpray(mobj_t *mo)
 {
     int         i;
 
+    P_StartHitscanBatch(mo->target);
+
     // offset angles from its attack angle
     for (i = 0; i < 40; i++)
     {
@@ -630,6 +640,8 @@ void A_BFGSpray(mobj_t *mo)
 
         P_DamageMobj(linetarget, mo->target, mo->target, damage);
     }
+
+    P_EndHitscanBatch();
 }
 
 //
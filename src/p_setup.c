@@ -29,10 +29,13 @@
 #include "g_game.h"
 #include "i_swap.h"
 #include "i_system.h"
+#include "m_argv.h"
 #include "m_bbox.h"
+#include "m_inflate.h"
 #include "m_misc.h"
 #include "p_fix.h"
 #include "p_local.h"
+#include "p_nodes.h"
 #include "s_sound.h"
 #include "w_wad.h"
 #include "z_zone.h"
@@ -80,12 +83,17 @@ uint32_t        *blockmapindex;
 
 // offsets in blockmap are from here
 uint32_t        *blockmaphead;
+static unsigned int blockmapcount;
 
 // origin of block map
 fixed_t         bmaporgx;
 fixed_t         bmaporgy;
 
-// for thing chains
+// size of the blocks, set from blockmap_size
+int             blockmapsize = BLOCKMAPSIZE_DEFAULT;
+int             blockmapshift = 7;
+
+// for thing chains, NUMBLOCKCLASSES per block
 mobj_t          **blocklinks;
 
 // REJECT
@@ -107,6 +115,18 @@ mapthing_t      playerstarts[MAXPLAYERS];
 
 boolean         canmodify;
 
+// the format the level's nodes were built in
+typedef enum
+{
+    DOOMBSP,
+    DEEPBSP,
+    ZDBSP,
+    COMPRESSEDZDBSP,
+    BUILTBSP
+} nodesformat_t;
+
+static nodesformat_t    nodesformat;
+
 static int current_episode = -1;
 static int current_map = -1;
 static int samelevel = false;
@@ -190,154 +210,183 @@ void P_LoadVertexes(int lump)
 }
 
 //
-// P_LoadSegs
+// P_SetupSeg
+// Fills in a seg from its vertexes, linedef and side, whatever node
+// format they were read from.
 //
-void P_LoadSegs(int lump)
+static void P_SetupSeg(seg_t *li, unsigned int v1, unsigned int v2, int linedef, int side,
+    angle_t angle)
 {
-    const mapseg_t      *data;
-    int                 i;
+    line_t      *ldef;
 
-    numsegs = W_LumpLength(lump) / sizeof(mapseg_t);
-    segs = calloc_IfSameLevel(segs, numsegs, sizeof(seg_t));
-    memset(segs, 0, numsegs * sizeof(seg_t));
-    data = (const mapseg_t *)W_CacheLumpNum(lump, PU_STATIC);
+    li->angle = angle;
 
-    for (i = 0; i < numsegs; i++)
-    {
-        seg_t           *li = segs + i;
-        const mapseg_t  *ml = data + i;
-        unsigned short  v1, v2;
-        int             side, linedef;
-        line_t          *ldef;
+    if (linedef < 0 || linedef >= numlines)
+        I_Error("P_LoadSegs: invalid linedef %d", linedef);
 
-        v1 = (unsigned short)SHORT(ml->v1);
-        v2 = (unsigned short)SHORT(ml->v2);
+    ldef = &lines[linedef];
+    li->linedef = ldef;
 
-        li->angle = SHORT(ml->angle) << 16;
-        linedef = (unsigned short)SHORT(ml->linedef);
+    // e6y: fix wrong side index
+    if (side != 0 && side != 1)
+        side = 1;
 
-        if (linedef < 0 || linedef >= numlines)
-            I_Error("P_LoadSegs: invalid linedef %d", linedef);
+    li->sidedef = &sides[ldef->sidenum[side]];
 
-        ldef = &lines[linedef];
-        li->linedef = ldef;
+    // cph 2006/09/30 - our frontsector can be the second side of the
+    // linedef, so must check for NO_INDEX in case we are incorrectly
+    // referencing the back of a 1S line
+    if (ldef->sidenum[side] != NO_INDEX)
+        li->frontsector = sides[ldef->sidenum[side]].sector;
+    else
+        li->frontsector = 0;
 
-        side = SHORT(ml->side);
+    if (ldef-> flags & ML_TWOSIDED)
+    {
+        int sidenum = ldef->sidenum[side ^ 1];
 
-        // e6y: fix wrong side index
-        if (side != 0 && side != 1)
-            side = 1;
+        // If the sidenum is out of range, this may be a "glass hack"
+        // impassible window.  Point at side #0 (this may not be
+        // the correct Vanilla behavior; however, it seems to work for
+        // OTTAWAU.WAD, which is the one place I've seen this trick
+        // used).
+        if (sidenum < 0 || sidenum >= numsides)
+            sidenum = 0;
 
-        li->sidedef = &sides[ldef->sidenum[side]];
+        li->backsector = sides[sidenum].sector;
+    }
+    else
+        li->backsector = 0;
 
-        // cph 2006/09/30 - our frontsector can be the second side of the
-        // linedef, so must check for NO_INDEX in case we are incorrectly
-        // referencing the back of a 1S line
-        if (ldef->sidenum[side] != NO_INDEX)
-            li->frontsector = sides[ldef->sidenum[side]].sector;
-        else
-            li->frontsector = 0;
+    // e6y
+    // check and fix wrong references to non-existent vertexes
+    // see e1m9 @ NIVELES.WAD
+    // http://www.doomworld.com/idgames/index.php?id=12647
+    if (v1 >= (unsigned int)numvertexes || v2 >= (unsigned int)numvertexes)
+    {
 
-        if (ldef-> flags & ML_TWOSIDED)
+        if (li->sidedef == &sides[li->linedef->sidenum[0]])
         {
-            int sidenum = ldef->sidenum[side ^ 1];
-
-            // If the sidenum is out of range, this may be a "glass hack"
-            // impassible window.  Point at side #0 (this may not be
-            // the correct Vanilla behavior; however, it seems to work for
-            // OTTAWAU.WAD, which is the one place I've seen this trick
-            // used).
-            if (sidenum < 0 || sidenum >= numsides)
-                sidenum = 0;
-
-            li->backsector = sides[sidenum].sector;
+            li->v1 = lines[linedef].v1;
+            li->v2 = lines[linedef].v2;
         }
         else
-            li->backsector = 0;
-
-        // e6y
-        // check and fix wrong references to non-existent vertexes
-        // see e1m9 @ NIVELES.WAD
-        // http://www.doomworld.com/idgames/index.php?id=12647
-        if (v1 >= numvertexes || v2 >= numvertexes)
         {
-
-            if (li->sidedef == &sides[li->linedef->sidenum[0]])
-            {
-                li->v1 = lines[ml->linedef].v1;
-                li->v2 = lines[ml->linedef].v2;
-            }
-            else
-            {
-                li->v1 = lines[ml->linedef].v2;
-                li->v2 = lines[ml->linedef].v1;
-            }
-        }
-        else
-        {
-            li->v1 = &vertexes[v1];
-            li->v2 = &vertexes[v2];
+            li->v1 = lines[linedef].v2;
+            li->v2 = lines[linedef].v1;
         }
+    }
+    else
+    {
+        li->v1 = &vertexes[v1];
+        li->v2 = &vertexes[v2];
+    }
 
-        // From Odamex:
-        {
-            // Recalculate seg offsets. Values in wads are untrustworthy.
-            vertex_t *from = (side == 0)
-                ? ldef->v1         // right side: offset is from start of linedef
-                : ldef->v2;        // left side: offset is from end of linedef
-            vertex_t *to = li->v1; // end point is start of seg, in both cases
+    // From Odamex:
+    {
+        // Recalculate seg offsets. Values in wads are untrustworthy.
+        vertex_t *from = (side == 0)
+            ? ldef->v1         // right side: offset is from start of linedef
+            : ldef->v2;        // left side: offset is from end of linedef
+        vertex_t *to = li->v1; // end point is start of seg, in both cases
 
-            float dx = (float)(to->x - from->x);
-            float dy = (float)(to->y - from->y);
+        float dx = (float)(to->x - from->x);
+        float dy = (float)(to->y - from->y);
 
-            li->offset = (fixed_t)sqrt(dx * dx + dy * dy);
-        }
+        li->offset = (fixed_t)sqrt(dx * dx + dy * dy);
+    }
 
-        // Apply any level-specific fixes.
-        if (canmodify)
-        {
-            int j = 0;
+    // Apply any level-specific fixes.
+    if (canmodify)
+    {
+        int j = 0;
 
-            while (linefix[j].mission != -1)
+        while (linefix[j].mission != -1)
+        {
+            if (linedef == linefix[j].linedef
+                && gamemission == linefix[j].mission
+                && gameepisode == linefix[j].epsiode
+                && gamemap == linefix[j].map
+                && side == linefix[j].side)
             {
-                if (linedef == linefix[j].linedef
-                    && gamemission == linefix[j].mission
-                    && gameepisode == linefix[j].epsiode
-                    && gamemap == linefix[j].map
-                    && side == linefix[j].side)
+                if (linefix[j].toptexture[0] != '\0')
+                    li->sidedef->toptexture = R_TextureNumForName(linefix[j].toptexture);
+                if (linefix[j].middletexture[0] != '\0')
+                    li->sidedef->midtexture = R_TextureNumForName(linefix[j].middletexture);
+                if (linefix[j].bottomtexture[0] != '\0')
+                    li->sidedef->bottomtexture = R_TextureNumForName(linefix[j].bottomtexture);
+                if (linefix[j].offset != DEFAULT)
                 {
-                    if (linefix[j].toptexture[0] != '\0')
-                        li->sidedef->toptexture = R_TextureNumForName(linefix[j].toptexture);
-                    if (linefix[j].middletexture[0] != '\0')
-                        li->sidedef->midtexture = R_TextureNumForName(linefix[j].middletexture);
-                    if (linefix[j].bottomtexture[0] != '\0')
-                        li->sidedef->bottomtexture = R_TextureNumForName(linefix[j].bottomtexture);
-                    if (linefix[j].offset != DEFAULT)
-                    {
-                        li->offset = SHORT(linefix[j].offset) << FRACBITS;
-                        li->sidedef->textureoffset = 0;
-                    }
-                    if (linefix[j].rowoffset != DEFAULT)
-                        li->sidedef->rowoffset = SHORT(linefix[j].rowoffset) << FRACBITS;
-                    if (linefix[j].flags & ML_DONTDRAW)
-                        li->linedef->hidden = true;
-                    if (linefix[j].flags != DEFAULT)
-                    {
-                        if (li->linedef->flags & linefix[j].flags)
-                            li->linedef->flags &= ~linefix[j].flags;
-                        else
-                            li->linedef->flags |= linefix[j].flags;
-                    }
-                    if (linefix[j].special != DEFAULT)
-                        li->linedef->special = linefix[j].special;
-                    if (linefix[j].tag != DEFAULT)
-                        li->linedef->tag = linefix[j].tag;
-                    break;
+                    li->offset = SHORT(linefix[j].offset) << FRACBITS;
+                    li->sidedef->textureoffset = 0;
                 }
-                j++;
+                if (linefix[j].rowoffset != DEFAULT)
+                    li->sidedef->rowoffset = SHORT(linefix[j].rowoffset) << FRACBITS;
+                if (linefix[j].flags & ML_DONTDRAW)
+                    li->linedef->hidden = true;
+                if (linefix[j].flags != DEFAULT)
+                {
+                    if (li->linedef->flags & linefix[j].flags)
+                        li->linedef->flags &= ~linefix[j].flags;
+                    else
+                        li->linedef->flags |= linefix[j].flags;
+                }
+                if (linefix[j].special != DEFAULT)
+                    li->linedef->special = linefix[j].special;
+                if (linefix[j].tag != DEFAULT)
+                    li->linedef->tag = linefix[j].tag;
+                break;
             }
+            j++;
         }
     }
+}
+
+//
+// P_LoadSegs
+//
+void P_LoadSegs(int lump)
+{
+    const mapseg_t      *data;
+    int                 i;
+
+    numsegs = W_LumpLength(lump) / sizeof(mapseg_t);
+    segs = calloc_IfSameLevel(segs, numsegs, sizeof(seg_t));
+    memset(segs, 0, numsegs * sizeof(seg_t));
+    data = (const mapseg_t *)W_CacheLumpNum(lump, PU_STATIC);
+
+    for (i = 0; i < numsegs; i++)
+    {
+        const mapseg_t  *ml = data + i;
+
+        P_SetupSeg(segs + i, (unsigned short)SHORT(ml->v1), (unsigned short)SHORT(ml->v2),
+            (unsigned short)SHORT(ml->linedef), SHORT(ml->side), SHORT(ml->angle) << 16);
+    }
+
+    W_ReleaseLumpNum(lump);
+}
+
+//
+// P_LoadSegs_V4
+// Loads DeePBSP segs.
+//
+static void P_LoadSegs_V4(int lump)
+{
+    const mapseg_v4_t   *data;
+    int                 i;
+
+    numsegs = W_LumpLength(lump) / sizeof(mapseg_v4_t);
+    segs = calloc_IfSameLevel(segs, numsegs, sizeof(seg_t));
+    memset(segs, 0, numsegs * sizeof(seg_t));
+    data = (const mapseg_v4_t *)W_CacheLumpNum(lump, PU_STATIC);
+
+    for (i = 0; i < numsegs; i++)
+    {
+        const mapseg_v4_t       *ml = data + i;
+
+        P_SetupSeg(segs + i, LONG(ml->v1), LONG(ml->v2), (unsigned short)SHORT(ml->linedef),
+            SHORT(ml->side), SHORT(ml->angle) << 16);
+    }
 
     W_ReleaseLumpNum(lump);
 }
@@ -365,6 +414,30 @@ void P_LoadSubsectors(int lump)
     W_ReleaseLumpNum(lump);
 }
 
+//
+// P_LoadSubsectors_V4
+// Loads DeePBSP subsectors.
+//
+static void P_LoadSubsectors_V4(int lump)
+{
+    const mapsubsector_v4_t     *data;
+    int                         i;
+
+    numsubsectors = W_LumpLength(lump) / sizeof(mapsubsector_v4_t);
+    subsectors = calloc_IfSameLevel(subsectors, numsubsectors, sizeof(subsector_t));
+    data = (const mapsubsector_v4_t *)W_CacheLumpNum(lump, PU_STATIC);
+
+    memset(subsectors, 0, numsubsectors * sizeof(subsector_t));
+
+    for (i = 0; i < numsubsectors; i++)
+    {
+        subsectors[i].numlines = (unsigned short)SHORT(data[i].numsegs);
+        subsectors[i].firstline = LONG(data[i].firstseg);
+    }
+
+    W_ReleaseLumpNum(lump);
+}
+
 //
 // P_LoadSectors
 //
@@ -427,6 +500,28 @@ void P_LoadSectors(int lump)
     W_ReleaseLumpNum(lump);
 }
 
+//
+// P_SetNodeChild
+// Converts a child index read with the given subsector flag.
+//
+static int P_SetNodeChild(unsigned int child, unsigned int subsectorflag)
+{
+    if (child == (subsectorflag == 0x8000 ? 0xFFFF : 0xFFFFFFFF))
+        return -1;
+    else if (child & subsectorflag)
+    {
+        // Convert to extended type
+        child &= ~subsectorflag;
+
+        // haleyjd 11/06/10: check for invalid subsector reference
+        if (child >= (unsigned int)numsubsectors)
+            child = 0;
+
+        return (child | NF_SUBSECTOR);
+    }
+    return child;
+}
+
 //
 // P_LoadNodes
 //
@@ -454,21 +549,45 @@ void P_LoadNodes(int lump)
         {
             int k;
 
-            no->children[j] = (unsigned short)SHORT(mn->children[j]);
+            no->children[j] = P_SetNodeChild((unsigned short)SHORT(mn->children[j]), 0x8000);
 
-            if (no->children[j] == 0xFFFF)
-                no->children[j] = -1;
-            else if (no->children[j] & 0x8000)
-            {
-                // Convert to extended type
-                no->children[j] &= ~0x8000;
+            for (k = 0; k < 4; k++)
+                no->bbox[j][k] = SHORT(mn->bbox[j][k]) << FRACBITS;
+        }
+    }
 
-                // haleyjd 11/06/10: check for invalid subsector reference
-                if (no->children[j] >= numsubsectors)
-                    no->children[j] = 0;
+    W_ReleaseLumpNum(lump);
+}
 
-                no->children[j] |= NF_SUBSECTOR;
-            }
+//
+// P_LoadNodes_V4
+// Loads DeePBSP nodes, skipping the lump's signature.
+//
+static void P_LoadNodes_V4(int lump)
+{
+    const byte  *data;
+    int         i;
+
+    numnodes = (W_LumpLength(lump) - 8) / sizeof(mapnode_v4_t);
+    nodes = malloc_IfSameLevel(nodes, numnodes * sizeof(node_t));
+    data = (byte *)W_CacheLumpNum(lump, PU_STATIC) + 8;
+
+    for (i = 0; i < numnodes; i++)
+    {
+        node_t                  *no = nodes + i;
+        const mapnode_v4_t      *mn = (const mapnode_v4_t *)data + i;
+        int                     j;
+
+        no->x = SHORT(mn->x) << FRACBITS;
+        no->y = SHORT(mn->y) << FRACBITS;
+        no->dx = SHORT(mn->dx) << FRACBITS;
+        no->dy = SHORT(mn->dy) << FRACBITS;
+
+        for (j = 0; j < 2; j++)
+        {
+            int k;
+
+            no->children[j] = P_SetNodeChild(LONG(mn->children[j]), 0x80000000);
 
             for (k = 0; k < 4; k++)
                 no->bbox[j][k] = SHORT(mn->bbox[j][k]) << FRACBITS;
@@ -478,6 +597,176 @@ void P_LoadNodes(int lump)
     W_ReleaseLumpNum(lump);
 }
 
+//
+// P_ReadZNodesCount
+// Reads a count from extended nodes, as long as there's room for one.
+//
+static unsigned int P_ReadZNodesCount(const byte **p, const byte *end)
+{
+    unsigned int        count;
+
+    if (end - *p < 4)
+        I_Error("P_LoadZNodes: nodes are truncated");
+
+    count = LONG(*(const unsigned int *)*p);
+    *p += 4;
+    return count;
+}
+
+//
+// P_LoadZNodes
+// Loads ZDoom extended nodes, which hold the subsectors and segs as
+// well as any vertexes the node builder added. The data starts after the
+// signature.
+//
+static void P_LoadZNodes(const byte *data, int length)
+{
+    const byte          *end = data + length;
+    const byte          *p = data;
+    unsigned int        orgverts, newverts;
+    unsigned int        numzsegs;
+    unsigned int        count;
+    int                 i, first;
+
+    // vertexes
+    orgverts = P_ReadZNodesCount(&p, end);
+    newverts = P_ReadZNodesCount(&p, end);
+
+    if (orgverts > (unsigned int)numvertexes || newverts > (unsigned int)(end - p) / 8
+        || orgverts + newverts > INT_MAX / sizeof(vertex_t))
+        I_Error("P_LoadZNodes: invalid vertexes");
+
+    if (orgverts + newverts != (unsigned int)numvertexes)
+    {
+        vertex_t        *oldvertexes = vertexes;
+
+        if (!(vertexes = realloc(vertexes, (orgverts + newverts) * sizeof(vertex_t))))
+            I_Error("P_LoadZNodes: Failure trying to allocate %u vertexes", orgverts + newverts);
+
+        // the linedefs point into the old array
+        for (i = 0; i < numlines; i++)
+        {
+            lines[i].v1 = vertexes + (lines[i].v1 - oldvertexes);
+            lines[i].v2 = vertexes + (lines[i].v2 - oldvertexes);
+        }
+    }
+
+    for (i = 0; i < (int)newverts; i++)
+    {
+        vertexes[orgverts + i].x = LONG(*(const fixed_t *)p);
+        vertexes[orgverts + i].y = LONG(*(const fixed_t *)(p + 4));
+        p += 8;
+    }
+    numvertexes = orgverts + newverts;
+
+    // subsectors
+    count = P_ReadZNodesCount(&p, end);
+
+    if (!count || count > (unsigned int)(end - p) / 4)
+        I_Error("P_LoadZNodes: no subsectors in level");
+    numsubsectors = count;
+
+    subsectors = calloc_IfSameLevel(subsectors, numsubsectors, sizeof(subsector_t));
+    memset(subsectors, 0, numsubsectors * sizeof(subsector_t));
+
+    for (i = first = 0; i < numsubsectors; i++)
+    {
+        subsectors[i].firstline = first;
+        count = LONG(*(const unsigned int *)p);
+        if (count > (unsigned int)(INT_MAX - first))
+            I_Error("P_LoadZNodes: incorrect number of segs in nodes");
+        subsectors[i].numlines = count;
+        first += count;
+        p += 4;
+    }
+
+    // segs
+    numzsegs = P_ReadZNodesCount(&p, end);
+
+    if (numzsegs != (unsigned int)first || numzsegs > (unsigned int)(end - p) / sizeof(mapseg_znod_t))
+        I_Error("P_LoadZNodes: incorrect number of segs in nodes");
+
+    numsegs = numzsegs;
+    segs = calloc_IfSameLevel(segs, numsegs, sizeof(seg_t));
+    memset(segs, 0, numsegs * sizeof(seg_t));
+
+    for (i = 0; i < numsegs; i++)
+    {
+        const mapseg_znod_t     *ml = (const mapseg_znod_t *)p + i;
+        unsigned int            v1 = LONG(ml->v1);
+        unsigned int            v2 = LONG(ml->v2);
+        angle_t                 angle = 0;
+
+        if (v1 < (unsigned int)numvertexes && v2 < (unsigned int)numvertexes)
+            angle = R_PointToAngle2(vertexes[v1].x, vertexes[v1].y, vertexes[v2].x, vertexes[v2].y);
+
+        P_SetupSeg(segs + i, v1, v2, (unsigned short)SHORT(ml->linedef), ml->side, angle);
+    }
+    p += numsegs * sizeof(mapseg_znod_t);
+
+    // nodes
+    count = P_ReadZNodesCount(&p, end);
+
+    if (count > (unsigned int)(end - p) / sizeof(mapnode_znod_t))
+        I_Error("P_LoadZNodes: invalid nodes");
+    numnodes = count;
+
+    nodes = malloc_IfSameLevel(nodes, numnodes * sizeof(node_t));
+
+    for (i = 0; i < numnodes; i++)
+    {
+        node_t                  *no = nodes + i;
+        const mapnode_znod_t    *mn = (const mapnode_znod_t *)p + i;
+        int                     j;
+
+        no->x = SHORT(mn->x) << FRACBITS;
+        no->y = SHORT(mn->y) << FRACBITS;
+        no->dx = SHORT(mn->dx) << FRACBITS;
+        no->dy = SHORT(mn->dy) << FRACBITS;
+
+        for (j = 0; j < 2; j++)
+        {
+            int k;
+
+            no->children[j] = P_SetNodeChild(LONG(mn->children[j]), 0x80000000);
+
+            for (k = 0; k < 4; k++)
+                no->bbox[j][k] = SHORT(mn->bbox[j][k]) << FRACBITS;
+        }
+    }
+}
+
+//
+// P_CheckNodesFormat
+// Returns the format the map's nodes were built in, or BUILTBSP if they
+// are missing and must be built.
+//
+static nodesformat_t P_CheckNodesFormat(int lumpnum)
+{
+    const byte  *data;
+    int         length = W_LumpLength(lumpnum + ML_NODES);
+
+    if (M_CheckParm("-buildnodes"))
+        return BUILTBSP;
+
+    if (length >= 8)
+    {
+        data = (byte *)W_CacheLumpNum(lumpnum + ML_NODES, PU_CACHE);
+
+        if (!memcmp(data, "xNd4\0\0\0\0", 8))
+            return DEEPBSP;
+        else if (!memcmp(data, "XNOD", 4))
+            return ZDBSP;
+        else if (!memcmp(data, "ZNOD", 4))
+            return COMPRESSEDZDBSP;
+    }
+
+    if (!W_LumpLength(lumpnum + ML_SSECTORS) || !W_LumpLength(lumpnum + ML_SEGS))
+        return BUILTBSP;
+
+    return DOOMBSP;
+}
+
 //
 // P_LoadThings
 //
@@ -694,6 +983,24 @@ void P_LoadSideDefs(int lump)
     W_ReleaseLumpNum(lump);
 }
 
+//
+// P_InitBlockMap
+// Sets up the blockmap globals from the header of blockmaphead.
+//
+static void P_InitBlockMap(void)
+{
+    bmaporgx = blockmaphead[0] << FRACBITS;
+    bmaporgy = blockmaphead[1] << FRACBITS;
+    bmapwidth = blockmaphead[2];
+    bmapheight = blockmaphead[3];
+    blockmapindex = &blockmaphead[4];
+
+    // clear out mobj chains
+    blocklinks = calloc_IfSameLevel(blocklinks, bmapwidth * bmapheight * NUMBLOCKCLASSES,
+        sizeof(*blocklinks));
+    memset(blocklinks, 0, sizeof(*blocklinks) * bmapwidth * bmapheight * NUMBLOCKCLASSES);
+}
+
 //
 // P_LoadBlockMap
 //
@@ -701,7 +1008,7 @@ void P_LoadSideDefs(int lump)
 // Expand from 16bit wad to internal 32bit blockmap.
 // (Taken from Doom Legacy)
 //
-void P_LoadBlockMap(int lump)
+boolean P_LoadBlockMap(int lump)
 {
     unsigned int        count = W_LumpLength(lump) / 2;                    // number of 16 bit blockmap entries
     uint16_t            *wadblockmaplump = W_CacheLumpNum(lump, PU_LEVEL); // blockmap lump temp
@@ -712,8 +1019,10 @@ void P_LoadBlockMap(int lump)
 
     // [WDJ] when zennode has not been run, this code will corrupt Zone memory.
     // It assumes a minimum size blockmap.
-    if (count < 5)
-        I_Error("Missing blockmap, node builder has not been run.\n");
+    // Instead it's built once the linedefs are loaded, as it is when
+    // blocks smaller than the WAD's are wanted.
+    if (count < 5 || M_CheckParm("-blockmap") || blockmapsize != BLOCKMAPSIZE_DEFAULT)
+        return false;
 
     // [WDJ] Do endian as read from blockmap lump temp
     blockmaphead = malloc_IfSameLevel(blockmaphead, sizeof(*blockmaphead) * count);
@@ -727,12 +1036,9 @@ void P_LoadBlockMap(int lump)
     blockmaphead[1] = LE_SWAP16(wadblockmaplump[1]);            // map orgin_y
     blockmaphead[2] = LE_SWAP16(wadblockmaplump[2]);            // number columns (x size)
     blockmaphead[3] = LE_SWAP16(wadblockmaplump[3]);            // number rows (y size)
+    blockmapcount = count;
 
-    bmaporgx = blockmaphead[0] << FRACBITS;
-    bmaporgy = blockmaphead[1] << FRACBITS;
-    bmapwidth = blockmaphead[2];
-    bmapheight = blockmaphead[3];
-    blockmapindex = &blockmaphead[4];
+    P_InitBlockMap();
     firstlist = 4 + bmapwidth * bmapheight;
     lastlist = count - 1;
 
@@ -785,10 +1091,20 @@ void P_LoadBlockMap(int lump)
 
         blockmaphead[i] = (bme == 0xffff ? (uint32_t)(-1) : (uint32_t)bme);
     }
+    return true;
+}
 
-    // clear out mobj chains
-    blocklinks = calloc_IfSameLevel(blocklinks, bmapwidth * bmapheight, sizeof(*blocklinks));
-    memset(blocklinks, 0, sizeof(*blocklinks) * bmapwidth * bmapheight);
+//
+// P_CreateBlockMap
+// Builds the blockmap for a map that doesn't have one.
+//
+static void P_CreateBlockMap(void)
+{
+    if (samelevel)
+        free(blockmaphead);
+
+    blockmaphead = P_BuildBlockMap(&blockmapcount);
+    P_InitBlockMap();
 }
 
 //
@@ -898,6 +1214,501 @@ static void P_GroupLines(void)
     }
 }
 
+//
+// REJECT BUILDING
+// When a map's REJECT lump is empty or truncated, P_LoadReject builds a
+// conservative table by flooding through the two-sided lines between
+// sectors, the way a PVS is built. A line of sight from one sector leaves
+// it through one of its two-sided lines, the source, and from there can
+// only reach a two-sided line of the next sector if part of it is in front
+// of the source, in front of the last line passed through, and between
+// the two separating lines that join the ends of those two lines. Heights
+// are ignored, as sectors can move. Anything a sector can't reach this way
+// is rejected. Sectors whose flood takes too long see everything.
+//
+#define REJECTSTEPS     8192    // lines flooded through per sector
+#define REJECTDEPTH     512     // lines passed through in a row
+#define REJECTEPSILON   0.01    // map units
+
+// a two-sided line, or what's left of it, facing the sector it leads into
+typedef struct
+{
+    double      x1, y1;
+    double      x2, y2;
+} rejectportal_t;
+
+static int      *rejectfirstline;       // index into rejectlines[] for each sector
+static int      *rejectlines;           // the two-sided lines around each sector
+static byte     *rejectlineused;        // lines already on the current path
+static byte     *rejectvisible;         // sectors seen from the current one
+static int      rejectsteps;
+
+//
+// P_RejectSide
+// Returns the distance of (x, y) in front of the line from (x1, y1) to
+// (x2, y2), where in front is a line's back side in Doom's terms.
+//
+static double P_RejectSide(double x1, double y1, double x2, double y2, double x, double y)
+{
+    double      dx = x2 - x1;
+    double      dy = y2 - y1;
+    double      length = sqrt(dx * dx + dy * dy);
+
+    return (length > 0.0 ? ((y - y1) * dx - (x - x1) * dy) / length : 0.0);
+}
+
+//
+// P_ClipRejectPortal
+// Clips portal to the part of it at least -REJECTEPSILON in front of the
+// line from (x1, y1) to (x2, y2) if sign is 1, or behind it if sign is -1.
+// Returns false if none of it is.
+//
+static boolean P_ClipRejectPortal(rejectportal_t *portal, double x1, double y1,
+    double x2, double y2, double sign)
+{
+    double      d1 = sign * P_RejectSide(x1, y1, x2, y2, portal->x1, portal->y1);
+    double      d2 = sign * P_RejectSide(x1, y1, x2, y2, portal->x2, portal->y2);
+    double      t;
+
+    if (d1 < -REJECTEPSILON && d2 < -REJECTEPSILON)
+        return false;
+
+    if (d1 >= -REJECTEPSILON && d2 >= -REJECTEPSILON)
+        return true;
+
+    t = d1 / (d1 - d2);
+    if (d1 < 0.0)
+    {
+        portal->x1 += (portal->x2 - portal->x1) * t;
+        portal->y1 += (portal->y2 - portal->y1) * t;
+    }
+    else
+    {
+        portal->x2 = portal->x1 + (portal->x2 - portal->x1) * t;
+        portal->y2 = portal->y1 + (portal->y2 - portal->y1) * t;
+    }
+    return true;
+}
+
+//
+// P_ClipRejectPortalToView
+// Clips portal to what can be seen of it through source then pass. A line
+// joining an end of each with all of source on one side and all of pass
+// on the other has every such line of sight on pass's side beyond pass.
+//
+static boolean P_ClipRejectPortalToView(rejectportal_t *portal, const rejectportal_t *source,
+    const rejectportal_t *pass)
+{
+    const double        sx[2] = { source->x1, source->x2 };
+    const double        sy[2] = { source->y1, source->y2 };
+    const double        px[2] = { pass->x1, pass->x2 };
+    const double        py[2] = { pass->y1, pass->y2 };
+    int                 i, j;
+
+    for (i = 0; i < 2; i++)
+        for (j = 0; j < 2; j++)
+        {
+            double      ds = P_RejectSide(sx[i], sy[i], px[j], py[j], sx[i ^ 1], sy[i ^ 1]);
+            double      dp = P_RejectSide(sx[i], sy[i], px[j], py[j], px[j ^ 1], py[j ^ 1]);
+            double      sign;
+
+            if (fabs(ds) <= REJECTEPSILON && fabs(dp) <= REJECTEPSILON)
+                continue;
+            else if (ds <= REJECTEPSILON && dp >= -REJECTEPSILON)
+                sign = 1.0;
+            else if (ds >= -REJECTEPSILON && dp <= REJECTEPSILON)
+                sign = -1.0;
+            else
+                continue;
+
+            if (!P_ClipRejectPortal(portal, sx[i], sy[i], px[j], py[j], sign))
+                return false;
+        }
+    return true;
+}
+
+//
+// P_RejectPortal
+// Makes the portal through line from sector into the sector on its other
+// side, facing that sector.
+//
+static void P_RejectPortal(rejectportal_t *portal, const line_t *line, const sector_t *sector)
+{
+    const vertex_t      *v1 = (line->frontsector == sector ? line->v1 : line->v2);
+    const vertex_t      *v2 = (line->frontsector == sector ? line->v2 : line->v1);
+
+    portal->x1 = (double)v1->x / FRACUNIT;
+    portal->y1 = (double)v1->y / FRACUNIT;
+    portal->x2 = (double)v2->x / FRACUNIT;
+    portal->y2 = (double)v2->y / FRACUNIT;
+}
+
+//
+// P_FloodReject
+// Marks every sector that can be seen from source through pass and on
+// from sector, which pass leads into. Returns false once it has taken too
+// long or gone too deep.
+//
+static boolean P_FloodReject(const rejectportal_t *source, const rejectportal_t *pass, int sector,
+    int depth)
+{
+    int i;
+
+    for (i = rejectfirstline[sector]; i < rejectfirstline[sector + 1]; i++)
+    {
+        const line_t    *line = lines + rejectlines[i];
+        const sector_t  *other;
+        rejectportal_t  portal;
+
+        if (rejectlineused[rejectlines[i]])
+            continue;
+
+        other = (line->frontsector == sectors + sector ? line->backsector : line->frontsector);
+        P_RejectPortal(&portal, line, sectors + sector);
+
+        if (!P_ClipRejectPortal(&portal, source->x1, source->y1, source->x2, source->y2, 1.0))
+            continue;
+        if (pass != source
+            && (!P_ClipRejectPortal(&portal, pass->x1, pass->y1, pass->x2, pass->y2, 1.0)
+                || !P_ClipRejectPortalToView(&portal, source, pass)))
+            continue;
+
+        rejectvisible[other - sectors] = 1;
+
+        if (++rejectsteps > REJECTSTEPS || depth >= REJECTDEPTH)
+            return false;
+
+        rejectlineused[rejectlines[i]] = 1;
+        if (!P_FloodReject(source, &portal, other - sectors, depth + 1))
+            return false;
+        rejectlineused[rejectlines[i]] = 0;
+    }
+    return true;
+}
+
+//
+// P_BuildReject
+// Fills rejectmatrix with every pair of sectors that can't see each other.
+//
+static void P_BuildReject(void)
+{
+    int i, j;
+
+    // list the two-sided lines between different sectors around each sector
+    rejectfirstline = (int *)calloc(numsectors + 1, sizeof(*rejectfirstline));
+    rejectlines = (int *)malloc(numlines * 2 * sizeof(*rejectlines));
+    rejectlineused = (byte *)calloc(numlines, 1);
+    rejectvisible = (byte *)malloc(numsectors);
+    if (!rejectfirstline || !rejectlines || !rejectlineused || !rejectvisible)
+        I_Error("P_BuildReject: Failure trying to allocate memory");
+
+    for (i = 0; i < numlines; i++)
+        if (lines[i].backsector && lines[i].backsector != lines[i].frontsector)
+        {
+            rejectfirstline[lines[i].frontsector - sectors]++;
+            rejectfirstline[lines[i].backsector - sectors]++;
+        }
+    for (i = 1; i <= numsectors; i++)
+        rejectfirstline[i] += rejectfirstline[i - 1];
+    for (i = numlines; i--;)
+        if (lines[i].backsector && lines[i].backsector != lines[i].frontsector)
+        {
+            rejectlines[--rejectfirstline[lines[i].frontsector - sectors]] = i;
+            rejectlines[--rejectfirstline[lines[i].backsector - sectors]] = i;
+        }
+
+    // record what each sector can see, one row at a time
+    for (i = 0; i < numsectors; i++)
+    {
+        boolean finished = true;
+
+        memset(rejectvisible, 0, numsectors);
+        rejectvisible[i] = 1;
+        rejectsteps = 0;
+
+        for (j = rejectfirstline[i]; j < rejectfirstline[i + 1] && finished; j++)
+        {
+            const line_t        *line = lines + rejectlines[j];
+            const sector_t      *other = (line->frontsector == sectors + i ? line->backsector :
+                                    line->frontsector);
+            rejectportal_t      source;
+
+            P_RejectPortal(&source, line, sectors + i);
+            rejectvisible[other - sectors] = 1;
+            rejectlineused[rejectlines[j]] = 1;
+            finished = P_FloodReject(&source, &source, other - sectors, 1);
+            rejectlineused[rejectlines[j]] = 0;
+        }
+
+        if (!finished)
+        {
+            memset(rejectvisible, 1, numsectors);
+            memset(rejectlineused, 0, numlines);
+        }
+
+        for (j = 0; j < numsectors; j++)
+            if (rejectvisible[j])
+            {
+                int     pnum = i * numsectors + j;
+
+                rejectmatrix[pnum >> 3] |= (1 << (pnum & 7));
+            }
+    }
+
+    // a pair is rejected only if neither sector can see the other, so turn
+    //  the visible bits into reject bits
+    for (i = 0; i < numsectors; i++)
+        for (j = i; j < numsectors; j++)
+        {
+            int         p1 = i * numsectors + j;
+            int         p2 = j * numsectors + i;
+            boolean     seen = ((rejectmatrix[p1 >> 3] & (1 << (p1 & 7)))
+                            || (rejectmatrix[p2 >> 3] & (1 << (p2 & 7))));
+
+            if (seen)
+            {
+                rejectmatrix[p1 >> 3] &= ~(1 << (p1 & 7));
+                rejectmatrix[p2 >> 3] &= ~(1 << (p2 & 7));
+            }
+            else
+            {
+                rejectmatrix[p1 >> 3] |= (1 << (p1 & 7));
+                rejectmatrix[p2 >> 3] |= (1 << (p2 & 7));
+            }
+        }
+
+    free(rejectfirstline);
+    free(rejectlines);
+    free(rejectlineused);
+    free(rejectvisible);
+}
+
+//
+// P_LoadReject
+// Many PWADs ship an empty or truncated REJECT lump, which leaves every
+// sight check to walk the BSP. In that case a table is built by
+// P_BuildReject instead, and any entries the lump does have are added to
+// it. Returns true if the table was built.
+//
+static boolean P_LoadReject(int lump)
+{
+    int64_t     bits = (int64_t)numsectors * numsectors;
+    int         size;
+    int         length = W_LumpLength(lump);
+    byte        *data = (byte *)W_CacheLumpNum(lump, PU_LEVEL);
+    int         i;
+
+    rejectmatrix = data;
+    rejectmatrixsize = length;
+
+    for (i = 0; i < length; i++)
+        if (data[i])
+            break;
+
+    if (i < length && (int64_t)length * 8 >= bits)
+        return false;
+
+    // every entry must be addressable by an int bit index, or the lump is
+    //  used as it is
+    if (bits > INT_MAX)
+        return false;
+    size = (int)((bits + 7) / 8);
+
+    rejectmatrix = (byte *)Z_Malloc(size, PU_LEVEL, 0);
+    rejectmatrixsize = size;
+    memset(rejectmatrix, 0, size);
+
+    P_BuildReject();
+
+    for (i = 0; i < (length < size ? length : size); i++)
+        rejectmatrix[i] |= data[i];
+    Z_ChangeTag(data, PU_CACHE);
+
+    return true;
+}
+
+//
+// LEVEL CACHE
+// A blockmap P_CreateBlockMap had to build, a REJECT table P_LoadReject
+// had to build and any nodes P_BuildNodes built are written to a cache file
+// named after a hash of the map's lumps, and read back from it the next
+// time the map is loaded. Anything the map's own lumps provide is left out,
+// and nothing is written if nothing was built. The cache is off unless
+// -levelcache is given, and kept in a folder next to the saved games.
+//
+#define LEVELCACHEDIR           "levelcache"
+#define LEVELCACHEID            "DRLC"
+#define LEVELCACHEVERSION       3
+
+typedef struct
+{
+    char                id[4];
+    int                 version;
+    uint32_t            hash;
+    unsigned int        blockmapcount;
+    int                 blockmapshift;
+    int                 forceblockmap;
+    int                 rejectmatrixsize;
+    int                 levelnodeslength;
+} levelcacheheader_t;
+
+// nodes built for the level, as an XNOD lump
+static byte             *levelnodes;
+static int              levelnodeslength;
+
+// what P_ReadLevelCache found in the cache
+static boolean          cachedblockmap;
+static boolean          cachedreject;
+
+//
+// P_LevelHash
+// Returns an FNV-1a hash of all of a map's lumps.
+//
+static uint32_t P_LevelHash(int lumpnum)
+{
+    uint32_t    hash = 2166136261u;
+    int         i;
+
+    for (i = ML_THINGS; i <= ML_BLOCKMAP; i++)
+    {
+        int     length = W_LumpLength(lumpnum + i);
+        byte    *data = (byte *)W_CacheLumpNum(lumpnum + i, PU_CACHE);
+        int     j;
+
+        for (j = 0; j < length; j++)
+            hash = (hash ^ data[j]) * 16777619u;
+        hash = (hash ^ length) * 16777619u;
+    }
+    return hash;
+}
+
+static char *P_LevelCacheDir(void)
+{
+    static char *dir = NULL;
+
+    if (dir == NULL)
+        dir = M_StringJoin(savegamedir, LEVELCACHEDIR, NULL);
+    return dir;
+}
+
+static char *P_LevelCacheName(uint32_t hash)
+{
+    static char         *name = NULL;
+    static size_t       name_size = 0;
+
+    if (name == NULL)
+    {
+        name_size = strlen(P_LevelCacheDir()) + 32;
+        name = malloc(name_size);
+    }
+
+    M_snprintf(name, name_size, "%s%s%08x.cache", P_LevelCacheDir(), DIR_SEPARATOR_S, hash);
+    return name;
+}
+
+//
+// P_ReadLevelCache
+// Loads whatever the cache file has for the level, and sets cachedblockmap
+// and cachedreject to say which of those it was.
+//
+static void P_ReadLevelCache(uint32_t hash)
+{
+    byte                *buffer;
+    levelcacheheader_t  header;
+    int                 length;
+
+    cachedblockmap = false;
+    cachedreject = false;
+
+    if (!M_FileExists(P_LevelCacheName(hash)))
+        return;
+
+    length = M_ReadFile(P_LevelCacheName(hash), &buffer);
+
+    if (length < (int)sizeof(header))
+    {
+        Z_Free(buffer);
+        return;
+    }
+
+    memcpy(&header, buffer, sizeof(header));
+
+    if (memcmp(header.id, LEVELCACHEID, sizeof(header.id)) || header.version != LEVELCACHEVERSION
+        || header.hash != hash || (header.blockmapcount && header.blockmapcount < 5)
+        || header.blockmapshift != blockmapshift
+        || header.forceblockmap != !!M_CheckParm("-blockmap")
+        || header.rejectmatrixsize < 0 || header.levelnodeslength < 0
+        || length != (int)(sizeof(header) + header.blockmapcount * sizeof(*blockmaphead)
+        + header.rejectmatrixsize + header.levelnodeslength))
+    {
+        Z_Free(buffer);
+        return;
+    }
+
+    if ((cachedblockmap = (header.blockmapcount > 0)))
+    {
+        blockmapcount = header.blockmapcount;
+        blockmaphead = malloc_IfSameLevel(blockmaphead, sizeof(*blockmaphead) * blockmapcount);
+        memcpy(blockmaphead, buffer + sizeof(header), sizeof(*blockmaphead) * blockmapcount);
+        P_InitBlockMap();
+    }
+
+    if ((cachedreject = (header.rejectmatrixsize > 0)))
+    {
+        rejectmatrixsize = header.rejectmatrixsize;
+        rejectmatrix = (byte *)Z_Malloc(rejectmatrixsize, PU_LEVEL, 0);
+        memcpy(rejectmatrix, buffer + sizeof(header) + sizeof(*blockmaphead) * header.blockmapcount,
+            rejectmatrixsize);
+    }
+
+    if ((levelnodeslength = header.levelnodeslength))
+    {
+        levelnodes = (byte *)malloc(levelnodeslength);
+        memcpy(levelnodes, buffer + length - levelnodeslength, levelnodeslength);
+    }
+
+    Z_Free(buffer);
+}
+
+//
+// P_WriteLevelCache
+// Writes the blockmap if withblockmap, the REJECT table if withreject and
+// any built nodes to the level's cache file.
+//
+static void P_WriteLevelCache(uint32_t hash, boolean withblockmap, boolean withreject)
+{
+    levelcacheheader_t  header;
+    unsigned int        count = (withblockmap ? blockmapcount : 0);
+    int                 rejectsize = (withreject ? rejectmatrixsize : 0);
+    int                 length = sizeof(header) + count * sizeof(*blockmaphead)
+                            + rejectsize + levelnodeslength;
+    byte                *buffer = (byte *)malloc(length);
+
+    if (!buffer)
+        return;
+
+    memcpy(header.id, LEVELCACHEID, sizeof(header.id));
+    header.version = LEVELCACHEVERSION;
+    header.hash = hash;
+    header.blockmapcount = count;
+    header.blockmapshift = blockmapshift;
+    header.forceblockmap = !!M_CheckParm("-blockmap");
+    header.rejectmatrixsize = rejectsize;
+    header.levelnodeslength = levelnodeslength;
+
+    memcpy(buffer, &header, sizeof(header));
+    if (count)
+        memcpy(buffer + sizeof(header), blockmaphead, count * sizeof(*blockmaphead));
+    if (rejectsize)
+        memcpy(buffer + sizeof(header) + count * sizeof(*blockmaphead), rejectmatrix, rejectsize);
+    if (levelnodeslength)
+        memcpy(buffer + length - levelnodeslength, levelnodes, levelnodeslength);
+
+    M_MakeDirectory(P_LevelCacheDir());
+    M_WriteFile(P_LevelCacheName(hash), buffer, length);
+    free(buffer);
+}
+
 //
 // killough 10/98
 //
@@ -1159,9 +1970,14 @@ extern boolean oldweaponsowned[];
 //
 void P_SetupLevel(int episode, int map)
 {
-    int  i;
-    char lumpname[6];
-    int  lumpnum;
+    int         i;
+    char        lumpname[6];
+    int         lumpnum;
+    uint32_t    levelhash = 0;
+    boolean     levelcache = M_CheckParm("-levelcache");
+    boolean     createblockmap;
+    boolean     buildreject = false;
+    boolean     buildnodes = false;
 
     totalkills = totalitems = totalsecret = wminfo.maxfrags = 0;
     wminfo.partime = 0;
@@ -1174,6 +1990,8 @@ void P_SetupLevel(int episode, int map)
 
     idclev = false;
 
+    P_ReportSightCache();
+
     // Make sure all sounds are stopped before Z_FreeTags.
     S_Start();
 
@@ -1220,25 +2038,86 @@ void P_SetupLevel(int episode, int map)
         free(vertexes);
     }
 
+    for (blockmapshift = 0; (1 << blockmapshift) < blockmapsize; blockmapshift++);
+
+    cachedblockmap = false;
+    cachedreject = false;
+    if (levelcache)
+    {
+        levelhash = P_LevelHash(lumpnum);
+        P_ReadLevelCache(levelhash);
+    }
+
     // note: most of this ordering is important
-    P_LoadBlockMap(lumpnum + ML_BLOCKMAP);
+    createblockmap = (!cachedblockmap && !P_LoadBlockMap(lumpnum + ML_BLOCKMAP));
     P_LoadVertexes(lumpnum + ML_VERTEXES);
     P_LoadSectors(lumpnum + ML_SECTORS);
     P_LoadSideDefs(lumpnum + ML_SIDEDEFS);
 
     P_LoadLineDefs(lumpnum + ML_LINEDEFS);
-    P_LoadSubsectors(lumpnum + ML_SSECTORS);
-    P_LoadNodes(lumpnum + ML_NODES);
-    P_LoadSegs(lumpnum + ML_SEGS);
 
-    rejectmatrix = (byte *)W_CacheLumpNum(lumpnum + ML_REJECT, PU_LEVEL);
-    rejectmatrixsize = W_LumpLength(lumpnum + ML_REJECT);
+    if (createblockmap)
+        P_CreateBlockMap();
+
+    nodesformat = P_CheckNodesFormat(lumpnum);
+    if (nodesformat == BUILTBSP)
+    {
+        buildnodes = !levelnodes;
+        if (buildnodes)
+            levelnodes = P_BuildNodes(&levelnodeslength);
+        P_LoadZNodes(levelnodes + 4, levelnodeslength - 4);
+    }
+    else if (nodesformat == ZDBSP)
+    {
+        P_LoadZNodes((byte *)W_CacheLumpNum(lumpnum + ML_NODES, PU_STATIC) + 4,
+            W_LumpLength(lumpnum + ML_NODES) - 4);
+        W_ReleaseLumpNum(lumpnum + ML_NODES);
+    }
+    else if (nodesformat == COMPRESSEDZDBSP)
+    {
+        int     length;
+        byte    *data = M_Inflate((byte *)W_CacheLumpNum(lumpnum + ML_NODES, PU_STATIC) + 4,
+                    W_LumpLength(lumpnum + ML_NODES) - 4, &length);
+
+        W_ReleaseLumpNum(lumpnum + ML_NODES);
+        if (!data)
+            I_Error("P_SetupLevel: compressed nodes are corrupt");
+        P_LoadZNodes(data, length);
+        free(data);
+    }
+    else if (nodesformat == DEEPBSP)
+    {
+        P_LoadSubsectors_V4(lumpnum + ML_SSECTORS);
+        P_LoadNodes_V4(lumpnum + ML_NODES);
+        P_LoadSegs_V4(lumpnum + ML_SEGS);
+    }
+    else
+    {
+        P_LoadSubsectors(lumpnum + ML_SSECTORS);
+        P_LoadNodes(lumpnum + ML_NODES);
+        P_LoadSegs(lumpnum + ML_SEGS);
+    }
+
+    if (!cachedreject)
+        buildreject = P_LoadReject(lumpnum + ML_REJECT);
+    if (levelcache && (createblockmap || buildreject || buildnodes))
+        P_WriteLevelCache(levelhash, createblockmap || cachedblockmap, buildreject || cachedreject);
+
+    free(levelnodes);
+    levelnodes = NULL;
+    levelnodeslength = 0;
+
     P_GroupLines();
 
+    P_InitSoundNeighbours();
+
     P_RemoveSlimeTrails();
 
     P_SetupWiggleFix();
 
+    R_InitRendSegs();
+    R_InitRendNodes();
+
     deathmatch_p = deathmatchstarts;
 
     bloodSplatQueueSlot = 0;
@@ -1281,4 +2160,6 @@ void P_Init(void)
     P_InitSwitchList();
     P_InitPicAnims();
     R_InitSprites(sprnames);
+    P_InitTicHash();
+    P_InitSightCache();
 }
@@ -23,6 +23,11 @@
 ========================================================================
 */
 
+#include <stdio.h>
+#include <string.h>
+
+#include "doomstat.h"
+#include "m_argv.h"
 #include "m_bbox.h"
 #include "p_local.h"
 
@@ -35,8 +40,116 @@ typedef struct los_s
     divline_t   strace;                 // from t1 to t2
     fixed_t     topslope, bottomslope;  // slopes to top and bottom of target
     fixed_t     bbox[4];
+    uint64_t    sectors;                // SIGHTCACHESECTOR() of sectors passed
 } los_t;
 
+//
+// Sight check results are cached until the end of the tic. Entries are
+// keyed by the pair of subsectors the looker and target are in and by the
+// band of heights of the looker's eyes and the target's bottom and top, so
+// a hit returns what the first look between the same places found. Each
+// entry also remembers which sectors the line of sight passed, hashed into
+// 64 bits, and is dropped once any of them moves.
+//
+#define SIGHTCACHESIZE          4096
+#define SIGHTCACHEBANDSHIFT     (FRACBITS + 3)
+#define SIGHTCACHESECTOR(s)     ((uint64_t)1 << (((s) - sectors) & 63))
+
+typedef struct
+{
+    int         stamp;
+    int         time;
+    int         subsector1, subsector2;
+    int         z1, bottom2, top2;
+    uint64_t    sectors;
+    boolean     result;
+} sightcache_t;
+
+static sightcache_t     sightcache[SIGHTCACHESIZE];
+static int              sightcachestamp = 1;
+
+// when each of the 64 sector hashes last moved this tic, and when any did
+static int              sightcachemoved[64];
+static int              sightcachetime;
+static int              sightcachelastmoved;
+static boolean          sightcacheactive = true;
+
+static int              sightcachehits;
+static int              sightcachemisses;
+
+//
+// P_InitSightCache
+//
+void P_InitSightCache(void)
+{
+    sightcacheactive = !M_CheckParm("-nosightcache");
+}
+
+//
+// P_ReportSightCache
+// Prints how often the cache was hit since the last report if -devparm was
+// used, then starts counting again. Called as each level is set up.
+//
+void P_ReportSightCache(void)
+{
+    int total = sightcachehits + sightcachemisses;
+
+    if (devparm && total)
+        printf("P_ReportSightCache: %i of %i sight checks (%i%%) hit the cache\n",
+            sightcachehits, total, (int)((int64_t)sightcachehits * 100 / total));
+
+    sightcachehits = 0;
+    sightcachemisses = 0;
+}
+
+//
+// P_ClearSightCache
+// Invalidates every cached sight check. Called at the start of each tic.
+//
+void P_ClearSightCache(void)
+{
+    if (++sightcachestamp == INT_MAX)
+    {
+        memset(sightcache, 0, sizeof(sightcache));
+        sightcachestamp = 1;
+    }
+
+    memset(sightcachemoved, 0, sizeof(sightcachemoved));
+    sightcachetime = 0;
+    sightcachelastmoved = 0;
+}
+
+//
+// P_SectorMovedSightCache
+// Invalidates the cached sight checks whose lines of sight passed through
+// a sector that has just moved.
+//
+void P_SectorMovedSightCache(sector_t *sector)
+{
+    sightcachelastmoved = sightcachemoved[(sector - sectors) & 63] = ++sightcachetime;
+}
+
+//
+// P_SightCacheEntryValid
+//
+static boolean P_SightCacheEntryValid(const sightcache_t *entry)
+{
+    uint64_t    mask = entry->sectors;
+    int         i;
+
+    if (entry->stamp != sightcachestamp)
+        return false;
+
+    if (sightcachelastmoved <= entry->time)
+        return true;
+
+    for (i = 0; mask; i++, mask >>= 1)
+        if ((mask & 1) && sightcachemoved[i] > entry->time)
+            return false;
+
+    return true;
+}
+
 //
 // P_DivlineSide
 // Returns side 0 (front), 1 (back), or 2 (on).
@@ -133,6 +246,7 @@ static boolean P_CrossSubsector(int num, los_t *los)
         // crosses a two sided line
         front = seg->frontsector;
         back = seg->backsector;
+        los->sectors |= SIGHTCACHESECTOR(front) | SIGHTCACHESECTOR(back);
 
         // no wall to block sight with?
         if (front->floorheight == back->floorheight && front->ceilingheight == back->ceilingheight)
@@ -198,8 +312,11 @@ boolean P_CheckSight(mobj_t *t1, mobj_t *t2)
 {
     const sector_t      *s1 = t1->subsector->sector;
     const sector_t      *s2 = t2->subsector->sector;
-    int                 pnum = (s1 - sectors) * numsectors + (s2 - sectors);
+    int64_t             pnum = (int64_t)(s1 - sectors) * numsectors + (s2 - sectors);
     los_t               los;
+    sightcache_t        *entry;
+    int                 subsector1, subsector2;
+    int                 z1, bottom2, top2;
 
     if (!t1 || !t2)
         return false;
@@ -234,6 +351,39 @@ boolean P_CheckSight(mobj_t *t1, mobj_t *t2)
     los.bbox[BOXTOP] = MAX(t1->y, t2->y);
     los.bbox[BOXBOTTOM] = MIN(t1->y, t2->y);
 
-    // the head node is the last node output
-    return P_CrossBSPNode(numnodes - 1, &los);
+    if (!sightcacheactive)
+        // the head node is the last node output
+        return P_CrossBSPNode(numnodes - 1, &los);
+
+    subsector1 = t1->subsector - subsectors;
+    subsector2 = t2->subsector - subsectors;
+    z1 = los.sightzstart >> SIGHTCACHEBANDSHIFT;
+    bottom2 = t2->z >> SIGHTCACHEBANDSHIFT;
+    top2 = (t2->z + t2->height) >> SIGHTCACHEBANDSHIFT;
+
+    entry = &sightcache[((subsector1 * 31 + subsector2) * 31 + z1) & (SIGHTCACHESIZE - 1)];
+
+    if (entry->subsector1 == subsector1 && entry->subsector2 == subsector2
+        && entry->z1 == z1 && entry->bottom2 == bottom2 && entry->top2 == top2
+        && P_SightCacheEntryValid(entry))
+    {
+        sightcachehits++;
+        return entry->result;
+    }
+
+    sightcachemisses++;
+
+    los.sectors = SIGHTCACHESECTOR(s1) | SIGHTCACHESECTOR(s2);
+
+    entry->stamp = sightcachestamp;
+    entry->time = sightcachetime;
+    entry->subsector1 = subsector1;
+    entry->subsector2 = subsector2;
+    entry->z1 = z1;
+    entry->bottom2 = bottom2;
+    entry->top2 = top2;
+    entry->result = P_CrossBSPNode(numnodes - 1, &los);
+    entry->sectors = los.sectors;
+
+    return entry->result;
 }
@@ -23,11 +23,27 @@
 ========================================================================
 */
 
+#include <stdio.h>
+
 #include "doomstat.h"
+#include "i_system.h"
+#include "m_argv.h"
+#include "m_random.h"
 #include "p_local.h"
 
 int     leveltime;
 
+//
+// TIC HASH
+// A hash of the gameplay-relevant world state is computed at the end of
+// every tic if -hashlog or -hashcompare is used. -hashlog writes the hash of
+// every tic (and of every mobj in it) to a file, and -hashcompare checks each
+// tic against such a file, stopping at the first tic that differs. This is
+// used to verify that changes to the play simulation are bit-exact.
+//
+static FILE     *hashlogfile;
+static FILE     *hashcomparefile;
+
 //
 // THINKERS
 // All thinkers should be allocated by Z_Malloc
@@ -91,6 +107,165 @@ void P_RunThinkers(void)
     }
 }
 
+//
+// P_HashInt
+// FNV-1a, applied to a whole 32-bit value at a time.
+//
+static uint32_t P_HashInt(uint32_t hash, int value)
+{
+    return ((hash ^ (uint32_t)value) * 16777619);
+}
+
+static uint32_t P_HashMobj(mobj_t *mobj)
+{
+    uint32_t    hash = 2166136261;
+
+    hash = P_HashInt(hash, mobj->type);
+    hash = P_HashInt(hash, mobj->x);
+    hash = P_HashInt(hash, mobj->y);
+    hash = P_HashInt(hash, mobj->z);
+    hash = P_HashInt(hash, mobj->momx);
+    hash = P_HashInt(hash, mobj->momy);
+    hash = P_HashInt(hash, mobj->momz);
+    hash = P_HashInt(hash, mobj->angle);
+    hash = P_HashInt(hash, mobj->state ? mobj->state - states : -1);
+    hash = P_HashInt(hash, mobj->tics);
+    hash = P_HashInt(hash, mobj->health);
+    hash = P_HashInt(hash, mobj->flags);
+    hash = P_HashInt(hash, mobj->movedir);
+    hash = P_HashInt(hash, mobj->movecount);
+    hash = P_HashInt(hash, mobj->reactiontime);
+    hash = P_HashInt(hash, mobj->threshold);
+    return hash;
+}
+
+static uint32_t P_HashSectors(void)
+{
+    uint32_t    hash = 2166136261;
+    int         i;
+
+    for (i = 0; i < numsectors; i++)
+    {
+        hash = P_HashInt(hash, sectors[i].floorheight);
+        hash = P_HashInt(hash, sectors[i].ceilingheight);
+        hash = P_HashInt(hash, sectors[i].lightlevel);
+    }
+    return hash;
+}
+
+//
+// P_InitTicHash
+//
+void P_InitTicHash(void)
+{
+    int p = M_CheckParmWithArgs("-hashlog", 1);
+
+    if (p && !(hashlogfile = fopen(myargv[p + 1], "wt")))
+        I_Error("P_InitTicHash: Couldn't open %s.", myargv[p + 1]);
+
+    p = M_CheckParmWithArgs("-hashcompare", 1);
+    if (p && !(hashcomparefile = fopen(myargv[p + 1], "rt")))
+        I_Error("P_InitTicHash: Couldn't open %s.", myargv[p + 1]);
+}
+
+//
+// P_TicHash
+// Each tic is logged as a line with its hash, the hash of all sectors, the
+// play simulation's random number index and the number of mobjs, followed by
+// a line for each mobj with its index in the thinker list, type and hash.
+//
+static void P_TicHash(void)
+{
+    thinker_t   *th;
+    uint32_t    hash = 2166136261;
+    uint32_t    sectorhash = P_HashSectors();
+    int         nummobjs = 0;
+    int         reftic, refprndindex, refnummobjs;
+    uint32_t    refhash, refsectorhash;
+
+    hash = P_HashInt(hash, sectorhash);
+    hash = P_HashInt(hash, prndindex);
+
+    for (th = thinkercap.next; th != &thinkercap; th = th->next)
+        if (th->function.acp1 == (actionf_p1)P_MobjThinker)
+        {
+            hash = P_HashInt(hash, P_HashMobj((mobj_t *)th));
+            nummobjs++;
+        }
+
+    if (hashlogfile)
+    {
+        int i = 0;
+
+        fprintf(hashlogfile, "%i %08x %08x %i %i\n", leveltime, hash, sectorhash, prndindex,
+            nummobjs);
+        for (th = thinkercap.next; th != &thinkercap; th = th->next)
+            if (th->function.acp1 == (actionf_p1)P_MobjThinker)
+                fprintf(hashlogfile, "%i %i %08x\n", i++, ((mobj_t *)th)->type,
+                    P_HashMobj((mobj_t *)th));
+    }
+
+    if (!hashcomparefile)
+        return;
+
+    if (fscanf(hashcomparefile, "%i %x %x %i %i", &reftic, &refhash, &refsectorhash,
+        &refprndindex, &refnummobjs) != 5)
+    {
+        // ran past the end of the reference log
+        fclose(hashcomparefile);
+        hashcomparefile = NULL;
+        return;
+    }
+
+    if (reftic != leveltime)
+        I_Error("P_TicHash: Tic %i is tic %i in the reference log.", leveltime, reftic);
+
+    if (hash != refhash)
+    {
+        int i = 0;
+
+        if (sectorhash != refsectorhash)
+            I_Error("P_TicHash: Sectors diverge at tic %i.", leveltime);
+        if (prndindex != refprndindex)
+            I_Error("P_TicHash: Random number index diverges at tic %i (%i instead of %i).",
+                leveltime, prndindex, refprndindex);
+
+        for (th = thinkercap.next; th != &thinkercap; th = th->next)
+            if (th->function.acp1 == (actionf_p1)P_MobjThinker)
+            {
+                mobj_t      *mobj = (mobj_t *)th;
+                int         refindex, reftype;
+                uint32_t    refmobjhash;
+
+                if (i >= refnummobjs
+                    || fscanf(hashcomparefile, "%i %i %x", &refindex, &reftype,
+                        &refmobjhash) != 3)
+                    break;
+                if (mobj->type != (mobjtype_t)reftype || P_HashMobj(mobj) != refmobjhash)
+                    I_Error("P_TicHash: Mobj %i (type %i at %i, %i) diverges at tic %i.",
+                        i, mobj->type, mobj->x >> FRACBITS, mobj->y >> FRACBITS, leveltime);
+                i++;
+            }
+
+        I_Error("P_TicHash: Number of mobjs diverges at tic %i (%i instead of %i).",
+            leveltime, nummobjs, refnummobjs);
+    }
+    else
+    {
+        // skip this tic's mobjs
+        int i;
+
+        for (i = 0; i < refnummobjs; i++)
+        {
+            int         refindex, reftype;
+            uint32_t    refmobjhash;
+
+            if (fscanf(hashcomparefile, "%i %i %x", &refindex, &reftype, &refmobjhash) != 3)
+                break;
+        }
+    }
+}
+
 //
 // P_Ticker
 //
@@ -107,6 +282,7 @@ void P_Ticker(void)
         return;
 
     P_MapStart();
+    P_ClearSightCache();
 
     if (gamestate == GS_LEVEL)
         for (i = 0; i < MAXPLAYERS; i++)
@@ -119,6 +295,9 @@ void P_Ticker(void)
 
     P_MapEnd();
 
+    if (hashlogfile || hashcomparefile)
+        P_TicHash();
+
     // for par times
     leveltime++;
 }
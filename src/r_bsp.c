@@ -23,13 +23,24 @@
 ========================================================================
 */
 
+#include <stdint.h>
+#include <string.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 #include "doomstat.h"
 #include "m_bbox.h"
 #include "r_main.h"
 #include "r_plane.h"
 #include "r_things.h"
+#include "z_zone.h"
 
 seg_t           *curline;
+rendseg_t       *currendseg;
+rendseg_t       *rendsegs;
+rendnode_t      *rendnodes;
 side_t          *sidedef;
 line_t          *linedef;
 sector_t        *frontsector;
@@ -41,6 +52,14 @@ drawseg_t       *drawsegs;
 unsigned int    maxdrawsegs;
 drawseg_t       *ds_p;
 
+// explicit stack for R_RenderBSPNode(), deep enough for any tree
+static int      *bspstack;
+
+// bumped whenever the view moves, to invalidate rendnodes' bbox angles
+static unsigned int     bboxanglestamp;
+static fixed_t          bboxviewx;
+static fixed_t          bboxviewy;
+
 void R_StoreWallRange(int start, int stop);
 
 //
@@ -52,112 +71,209 @@ void R_ClearDrawSegs(void)
 }
 
 //
-// ClipWallSegment
-// Clips the given range of columns
-// and includes it in the new clip list.
+// R_InitRendSegs
+// Builds rendsegs[] from segs[]. Called once the level's vertexes are final.
 //
-typedef struct
+void R_InitRendSegs(void)
 {
-    int         first;
-    int         last;
-} cliprange_t;
+    int i;
+
+    rendsegs = Z_Malloc(numsegs * sizeof(*rendsegs), PU_LEVEL, NULL);
+
+    for (i = 0; i < numsegs; i++)
+    {
+        seg_t       *seg = segs + i;
+        rendseg_t   *rs = rendsegs + i;
+
+        rs->x1 = seg->v1->x;
+        rs->y1 = seg->v1->y;
+        rs->x2 = seg->v2->x;
+        rs->y2 = seg->v2->y;
+        rs->backsector = (seg->backsector ? seg->backsector - sectors : -1);
+        rs->normalangle = seg->angle + ANG90;
+        rs->fakecontrast = (rs->y1 == rs->y2 ? -LIGHTBRIGHT : (rs->x1 == rs->x2 ? LIGHTBRIGHT : 0));
+    }
+}
 
-// 1/11/98: Lee Killough
 //
-// This fixes many strange venetian blinds crashes, which occurred when a scan
-// line had too many "posts" of alternating non-transparent and transparent
-// regions. Using a doubly-linked list to represent the posts is one way to
-// do it, but it has increased overhead and poor spatial locality, which hurts
-// cache performance on modern machines. Since the maximum number of posts
-// theoretically possible is a function of screen width, a static limit is
-// okay in this case. It used to be 32, which was way too small.
+// R_InitRendNodes
+// Builds rendnodes[] from nodes[], and the stack to traverse them with.
 //
-// This limit was frequently mistaken for the visplane limit in some Doom
-// editing FAQs, where visplanes were said to "double" if a pillar or other
-// object split the view's space into two pieces horizontally. That did not
-// have anything to do with visplanes, but it had everything to do with these
-// clip posts.
+void R_InitRendNodes(void)
+{
+    int i;
 
-#define MAXSEGS (SCREENWIDTH / 2 + 1)
+    rendnodes = Z_Malloc(numnodes * sizeof(*rendnodes), PU_LEVEL, NULL);
+    bspstack = Z_Malloc((numnodes + 1) * sizeof(*bspstack), PU_LEVEL, NULL);
 
-// newend is one past the last valid seg
-static cliprange_t      *newend;
-static cliprange_t      solidsegs[MAXSEGS];
+    for (i = 0; i < numnodes; i++)
+    {
+        node_t      *node = nodes + i;
+        rendnode_t  *rn = rendnodes + i;
+
+        rn->x = node->x;
+        rn->y = node->y;
+        rn->dx = node->dx;
+        rn->dy = node->dy;
+        rn->children[0] = node->children[0];
+        rn->children[1] = node->children[1];
+        memcpy(rn->bbox, node->bbox, sizeof(rn->bbox));
+        rn->anglestamp[0] = rn->anglestamp[1] = 0;
+    }
+
+    // make sure nothing cached for a previous level can be mistaken as valid
+    bboxanglestamp = 1;
+    bboxviewx = viewx;
+    bboxviewy = viewy;
+}
 
 //
-// R_ClipSolidWallSegment
-// Does handle solid walls,
-//  e.g. single sided LineDefs (middle texture)
-//  that entirely block the view.
+// ClipWallSegment
+// Clips the given range of columns
+// and includes it in the new clip list.
 //
-static void R_ClipSolidWallSegment(int first, int last)
-{
-    cliprange_t *next;
-    cliprange_t *start = solidsegs;
+// The clip list is a bitmask with one bit per column of the view, set
+// once a solid wall covers that column. Runs of columns are found and tested
+// a whole word at a time, so the cost follows the number of words a range
+// spans, not the number of ranges already on screen.
+//
+#define CLIPWORDBITS    64
+// one spare column past the widest view, for the solid columns from
+//  viewwidth on that R_ClearClipSegs() sets
+#define CLIPWORDS       (SCREENWIDTH / CLIPWORDBITS + 1)
 
-    // Find the first range that touches the range
-    //  (adjacent pixels are touching).
-    while (start->last < first - 1)
-        ++start;
+static uint64_t         solidcolumns[CLIPWORDS];
 
-    if (first < start->first)
-    {
-        if (last < start->first - 1)
-        {
-            // Post is entirely visible (above start), so insert a new clippost.
-            R_StoreWallRange(first, last);
+// true once every column of the view is solid
+static boolean          solidview;
 
-            // 1/11/98 killough: performance tuning using fast memmove
-            memmove(start + 1, start, (++newend - start) * sizeof(*start));
-            start->first = first;
-            start->last = last;
-            return;
-        }
+//
+// R_LowestBit
+// Returns the index of the lowest set bit in a non-zero word.
+//
+static __inline int R_LowestBit(uint64_t bits)
+{
+#if defined(__GNUC__)
+    return __builtin_ctzll(bits);
+#elif defined(_M_X64)
+    unsigned long       index;
 
-        // There is a fragment above *start.
-        R_StoreWallRange(first, start->first - 1);
+    _BitScanForward64(&index, bits);
+    return index;
+#else
+    int                 index = 0;
 
-        // Now adjust the clip size.
-        start->first = first;
+    while (!((uint32_t)bits))
+    {
+        bits >>= 32;
+        index += 32;
     }
+    while (!(bits & 1))
+    {
+        bits >>= 1;
+        index++;
+    }
+    return index;
+#endif
+}
 
-    // Bottom contained in start?
-    if (last <= start->last)
-        return;
+//
+// R_NextColumn
+// Returns the first column from x to last whose bit is set (if solid) or
+// clear (if !solid), or last + 1 if there is none.
+//
+static int R_NextColumn(int x, int last, boolean solid)
+{
+    int                 word = x / CLIPWORDBITS;
+    const int           lastword = last / CLIPWORDBITS;
+    const uint64_t      invert = (solid ? 0 : ~(uint64_t)0);
+    uint64_t            bits = (solidcolumns[word] ^ invert) & (~(uint64_t)0 << (x % CLIPWORDBITS));
 
-    next = start;
-    while (last >= (next + 1)->first - 1)
+    while (!bits)
     {
-        // There is a fragment between two posts.
-        R_StoreWallRange(next->last + 1, (next + 1)->first - 1);
-        ++next;
-
-        if (last <= next->last)
-        {
-            // Bottom is contained in next. Adjust the clip size.
-            start->last = next->last;
-            goto crunch;
-        }
+        if (++word > lastword)
+            return last + 1;
+        bits = solidcolumns[word] ^ invert;
     }
 
-    // There is a fragment after *next.
-    R_StoreWallRange(next->last + 1, last);
+    x = word * CLIPWORDBITS + R_LowestBit(bits);
+    return MIN(x, last + 1);
+}
+
+//
+// R_ColumnsSolid
+// Returns true if every column from first to last is solid.
+//
+static boolean R_ColumnsSolid(int first, int last)
+{
+    int                 word = first / CLIPWORDBITS;
+    const int           lastword = last / CLIPWORDBITS;
+    const uint64_t      firstmask = ~(uint64_t)0 << (first % CLIPWORDBITS);
+    const uint64_t      lastmask = ~(uint64_t)0 >> (CLIPWORDBITS - 1 - last % CLIPWORDBITS);
+
+    if (word == lastword)
+        return ((solidcolumns[word] & firstmask & lastmask) == (firstmask & lastmask));
+
+    if ((solidcolumns[word] & firstmask) != firstmask)
+        return false;
+    while (++word < lastword)
+        if (solidcolumns[word] != ~(uint64_t)0)
+            return false;
+    return ((solidcolumns[lastword] & lastmask) == lastmask);
+}
 
-    // Adjust the clip size.
-    start->last = last;
+//
+// R_MarkSolidColumns
+// Sets the bits of every column from first to last.
+//
+static void R_MarkSolidColumns(int first, int last)
+{
+    int                 word = first / CLIPWORDBITS;
+    const int           lastword = last / CLIPWORDBITS;
+    const uint64_t      firstmask = ~(uint64_t)0 << (first % CLIPWORDBITS);
+    const uint64_t      lastmask = ~(uint64_t)0 >> (CLIPWORDBITS - 1 - last % CLIPWORDBITS);
 
-    // Remove start + 1 to next from the clip list,
-    // because start now covers their area.
+    if (word == lastword)
+        solidcolumns[word] |= firstmask & lastmask;
+    else
+    {
+        solidcolumns[word] |= firstmask;
+        while (++word < lastword)
+            solidcolumns[word] = ~(uint64_t)0;
+        solidcolumns[lastword] |= lastmask;
+    }
+}
 
-crunch:
+//
+// R_ClipWallSegment
+// Stores every run of columns from first to last that isn't solid yet.
+//
+static void R_ClipWallSegment(int first, int last)
+{
+    while ((first = R_NextColumn(first, last, false)) <= last)
+    {
+        int     next = R_NextColumn(first, last, true);
 
-    if (next == start)
-        return;                 // Post just extended past the bottom of one post.
+        R_StoreWallRange(first, next - 1);
+        if ((first = next) > last)
+            break;
+    }
+}
 
-    while (next++ != newend)
-        *(++start) = *next;     // Remove a post.
+//
+// R_ClipSolidWallSegment
+// Does handle solid walls,
+//  e.g. single sided LineDefs (middle texture)
+//  that entirely block the view.
+//
+static void R_ClipSolidWallSegment(int first, int last)
+{
+    if (R_ColumnsSolid(first, last))
+        return;
 
-    newend = start;
+    R_ClipWallSegment(first, last);
+    R_MarkSolidColumns(first, last);
+    solidview = R_ColumnsSolid(0, viewwidth - 1);
 }
 
 //
@@ -169,42 +285,7 @@ crunch:
 //
 static void R_ClipPassWallSegment(int first, int last)
 {
-    cliprange_t *start = solidsegs;
-
-    // Find the first range that touches the range
-    //  (adjacent pixels are touching).
-    while (start->last < first - 1)
-        ++start;
-
-    if (first < start->first)
-    {
-        if (last < start->first - 1)
-        {
-            // Post is entirely visible (above start).
-            R_StoreWallRange(first, last);
-            return;
-        }
-
-        // There is a fragment above *start.
-        R_StoreWallRange(first, start->first - 1);
-    }
-
-    // Bottom contained in start?
-    if (last <= start->last)
-        return;
-
-    while (last >= (start + 1)->first - 1)
-    {
-        // There is a fragment between two posts.
-        R_StoreWallRange(start->last + 1, (start + 1)->first - 1);
-        ++start;
-
-        if (last <= start->last)
-            return;
-    }
-
-    // There is a fragment after *next.
-    R_StoreWallRange(start->last + 1, last);
+    R_ClipWallSegment(first, last);
 }
 
 //
@@ -212,11 +293,11 @@ static void R_ClipPassWallSegment(int first, int last)
 //
 void R_ClearClipSegs(void)
 {
-    solidsegs[0].first = INT_MIN + 1;
-    solidsegs[0].last = -1;
-    solidsegs[1].first = viewwidth;
-    solidsegs[1].last = INT_MAX - 1;
-    newend = solidsegs + 2;
+    // Everything right of the view is solid, as R_CheckBBox() can ask
+    //  about column viewwidth.
+    memset(solidcolumns, 0, sizeof(solidcolumns));
+    R_MarkSolidColumns(viewwidth, CLIPWORDS * CLIPWORDBITS - 1);
+    solidview = false;
 }
 
 // killough 1/18/98 -- This function is used to fix the automap bug which
@@ -246,7 +327,7 @@ int R_DoorClosed(void)
 // Clips the given segment
 // and adds any visible pieces to the line list.
 //
-static void R_AddLine(seg_t *line)
+static void R_AddLine(seg_t *line, rendseg_t *rs)
 {
     int         x1;
     int         x2;
@@ -256,13 +337,15 @@ static void R_AddLine(seg_t *line)
     angle_t     tspan;
 
     curline = line;
+    currendseg = rs;
 
     // skip this line if it's not facing the camera
-    if (R_PointOnSegSide(viewx, viewy, line) != 0)
+    if ((int64_t)(rs->x2 - rs->x1) * (viewy - rs->y1)
+        - (int64_t)(rs->y2 - rs->y1) * (viewx - rs->x1) >= 0)
         return;
 
-    angle1 = R_PointToAngle(line->v1->x, line->v1->y);
-    angle2 = R_PointToAngle(line->v2->x, line->v2->y);
+    angle1 = R_PointToAngle(rs->x1, rs->y1);
+    angle2 = R_PointToAngle(rs->x2, rs->y2);
 
     // Clip to view edges.
     span = angle1 - angle2;
@@ -312,7 +395,7 @@ static void R_AddLine(seg_t *line)
     if (x1 >= x2)
         return;
 
-    backsector = line->backsector;
+    backsector = (rs->backsector >= 0 ? sectors + rs->backsector : NULL);
 
     doorclosed = 0;
 
@@ -373,32 +456,39 @@ static const int checkcoord[12][4] =
     { 2, 1, 3, 0 }
 };
 
-static boolean R_CheckBBox(const fixed_t *bspcoord)
+static boolean R_CheckBBox(rendnode_t *bsp, int side)
 {
-    int         boxpos;
-    const int   *check;
-
     angle_t     angle1;
     angle_t     angle2;
 
-    cliprange_t *start;
-
     int         sx1;
     int         sx2;
 
-    // Find the corners of the box
-    // that define the edges from current viewpoint.
-    boxpos = (viewx <= bspcoord[BOXLEFT] ? 0 : viewx < bspcoord[BOXRIGHT ] ? 1 : 2) +
-             (viewy >= bspcoord[BOXTOP ] ? 0 : viewy > bspcoord[BOXBOTTOM] ? 4 : 8);
+    // Find the corners of the box that define the edges from current
+    //  viewpoint, unless the view hasn't moved since they were last found.
+    if (bsp->anglestamp[side] != bboxanglestamp)
+    {
+        const fixed_t   *bspcoord = bsp->bbox[side];
+        const int       boxpos = (viewx <= bspcoord[BOXLEFT] ? 0 : viewx < bspcoord[BOXRIGHT ] ? 1 : 2) +
+                                 (viewy >= bspcoord[BOXTOP ] ? 0 : viewy > bspcoord[BOXBOTTOM] ? 4 : 8);
 
-    if (boxpos == 5)
-        return true;
+        bsp->boxpos[side] = boxpos;
+        if (boxpos != 5)
+        {
+            const int   *check = checkcoord[boxpos];
 
-    check = checkcoord[boxpos];
+            bsp->angle1[side] = R_PointToAngle(bspcoord[check[0]], bspcoord[check[1]]);
+            bsp->angle2[side] = R_PointToAngle(bspcoord[check[2]], bspcoord[check[3]]);
+        }
+        bsp->anglestamp[side] = bboxanglestamp;
+    }
+
+    if (bsp->boxpos[side] == 5)
+        return true;
 
     // check clip list for an open space
-    angle1 = R_PointToAngle(bspcoord[check[0]], bspcoord[check[1]]) - viewangle;
-    angle2 = R_PointToAngle(bspcoord[check[2]], bspcoord[check[3]]) - viewangle;
+    angle1 = bsp->angle1[side] - viewangle;
+    angle2 = bsp->angle2[side] - viewangle;
 
     // cph - replaced old code, which was unclear and badly commented
     // Much more efficient code now
@@ -440,14 +530,8 @@ static boolean R_CheckBBox(const fixed_t *bspcoord)
 
     // SoM: Removed the "does not cross a pixel" test
 
-    start = solidsegs;
-    while (start->last < sx2)
-        ++start;
-
-    if (sx1 >= start->first && sx2 <= start->last)
-        return false;                   // The clippost contains the new span.
-
-    return true;
+    // The clip list contains the new span?
+    return !R_ColumnsSolid(sx1, sx2);
 }
 
 //
@@ -461,6 +545,7 @@ static void R_Subsector(int num)
     subsector_t *sub = &subsectors[num];
     int         count = sub->numlines;
     seg_t       *line = &segs[sub->firstline];
+    rendseg_t   *rs = &rendsegs[sub->firstline];
 
     frontsector = sub->sector;
 
@@ -479,31 +564,65 @@ static void R_Subsector(int num)
     R_AddSprites(frontsector);
 
     while (count--)
-        R_AddLine(line++);
+        R_AddLine(line++, rs++);
 }
 
 //
 // RenderBSPNode
 // Renders all subsectors below a given node,
-//  traversing subtree recursively.
+//  traversing subtree.
 // Just call with BSP root.
+//
+// Walks the tree with an explicit stack instead of recursing. Each
+// node passed on the way down to a subsector pushes its back side, which is
+// then popped and checked once everything in front of it has been drawn.
+//
 void R_RenderBSPNode(int bspnum)
 {
-    while (!(bspnum & NF_SUBSECTOR))    // Found a subsector?
+    int sp = 0;
+
+    if (viewx != bboxviewx || viewy != bboxviewy)
+    {
+        bboxviewx = viewx;
+        bboxviewy = viewy;
+        if (!++bboxanglestamp)
+            bboxanglestamp = 1;
+    }
+
+    while (!solidview)
     {
-        const node_t    *bsp = &nodes[bspnum];
+        while (!(bspnum & NF_SUBSECTOR))        // Found a subsector?
+        {
+            const rendnode_t    *bsp = &rendnodes[bspnum];
 
-        // Decide which side the view point is on.
-        int             side = R_PointOnSide(viewx, viewy, bsp);
+            // Decide which side the view point is on.
+            int                 side = ((int64_t)(viewy - bsp->y) * bsp->dx
+                                    + (int64_t)(bsp->x - viewx) * bsp->dy >= 0);
 
-        // Recursively divide front space.
-        R_RenderBSPNode(bsp->children[side]);
+            // Divide front space, and come back for the back space later.
+            bspstack[sp++] = (bspnum << 1) | (side ^ 1);
+            bspnum = bsp->children[side];
+        }
+        R_Subsector(bspnum == -1 ? 0 : (bspnum & ~NF_SUBSECTOR));
 
         // Possibly divide back space.
-        if (!R_CheckBBox(bsp->bbox[side ^= 1]))
-            return;
-
-        bspnum = bsp->children[side];
+        for (;;)
+        {
+            rendnode_t  *bsp;
+            int         side;
+
+            // nothing behind a solid screen can be seen
+            if (!sp || solidview)
+                return;
+
+            bspnum = bspstack[--sp];
+            bsp = &rendnodes[bspnum >> 1];
+            side = (bspnum & 1);
+            if (R_CheckBBox(bsp, side))
+            {
+                bspnum = bsp->children[side];
+                break;
+            }
+        }
     }
-    R_Subsector(bspnum == -1 ? 0 : (bspnum & ~NF_SUBSECTOR));
 }
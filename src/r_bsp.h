@@ -27,6 +27,8 @@
 #define __R_BSP__
 
 extern seg_t            *curline;
+extern rendseg_t        *currendseg;
+extern rendseg_t        *rendsegs;
 extern side_t           *sidedef;
 extern line_t           *linedef;
 extern sector_t         *frontsector;
@@ -45,6 +47,8 @@ typedef void (*drawfunc_t)(int start, int stop);
 void R_ClearClipSegs(void);
 void R_ClearDrawSegs(void);
 
+void R_InitRendSegs(void);
+void R_InitRendNodes(void);
 void R_RenderBSPNode(int bspnum);
 int R_DoorClosed(void);
 
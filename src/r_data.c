@@ -26,6 +26,7 @@
 #include "doomstat.h"
 #include "i_swap.h"
 #include "i_system.h"
+#include "m_argv.h"
 #include "m_misc.h"
 #include "p_local.h"
 #include "r_sky.h"
@@ -81,6 +82,13 @@ lighttable_t    *colormaps;
 boolean         *lookuptextures;
 int             lookupprogress;
 
+// With -textureatlas, R_PrecacheLevel() copies every column of the
+// textures a level uses into one block, at a fixed stride per texture, so
+// R_GetColumn() can just index into it.
+static byte     *textureatlas;
+static byte     **textureatlascolumns;  // NULL if texture isn't in the atlas
+static int      *textureatlasstride;
+
 static byte notgray[256] =
 {
     0,0,0,0,1,0,0,0,0,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
@@ -427,29 +435,151 @@ static void R_GenerateLookup(int texnum)
 }
 
 //
-// R_GetColumn
+// R_GetTextureColumn
 //
-byte *R_GetColumn(int tex, int col)
+static byte *R_GetTextureColumn(int tex, int col)
 {
     int         lump;
     int         ofs;
 
     if (lookuptextures[tex] == false)
+    {
+        R_FlushWallColumns();
         R_GenerateLookup(tex);
+    }
 
     col &= texturewidthmask[tex];
     lump = texturecolumnlump[tex][col];
     ofs = texturecolumnofs[tex][col];
 
+    // Draw any queued wall columns before anything they point into can
+    // be purged to make room.
     if (lump > 0)
+    {
+        if (!lumpinfo[lump].cache)
+            R_FlushWallColumns();
         return ((byte *)W_CacheLumpNum(lump, PU_CACHE) + ofs);
+    }
 
     if (!texturecomposite[tex])
+    {
+        R_FlushWallColumns();
         R_GenerateComposite(tex);
+    }
 
     return (texturecomposite[tex] + ofs);
 }
 
+//
+// R_GetColumn
+//
+byte *R_GetColumn(int tex, int col)
+{
+    byte        *columns = textureatlascolumns[tex];
+
+    if (columns)
+        return (columns + (col & texturewidthmask[tex]) * textureatlasstride[tex]);
+
+    return R_GetTextureColumn(tex, col);
+}
+
+//
+// R_TextureColumnStart
+// Returns where column x of texture tex starts, post header included, and
+// sets *end to the end of the patch or composite it's in.
+//
+static const byte *R_TextureColumnStart(int tex, int x, const byte **end)
+{
+    const byte  *start = R_GetTextureColumn(tex, x) - 3;
+    int         lump = texturecolumnlump[tex][x];
+
+    *end = (lump > 0 ? (byte *)W_CacheLumpNum(lump, PU_CACHE) + W_LumpLength(lump) :
+        texturecomposite[tex] + texturecompositesize[tex]);
+    return start;
+}
+
+//
+// R_TextureColumnSize
+// Returns how much of a column, starting at its post header, might be read:
+// the texture's height for walls, and all its posts for masked textures.
+//
+static int R_TextureColumnSize(const byte *start, const byte *end, int height)
+{
+    const byte  *post = start;
+
+    while (post < end && *post != 0xff)
+        post += post[1] + 4;
+
+    return MAX(height + 3, (int)(post + 1 - start));
+}
+
+//
+// R_BuildTextureAtlas
+// Copies the columns of all the textures in texturepresent into one block.
+//
+static void R_BuildTextureAtlas(const char *texturepresent)
+{
+    int         i;
+    int         x;
+    size_t      size = 0;
+    byte        *dest;
+
+    for (i = 0; i < numtextures; i++)
+    {
+        int     stride = 0;
+        int     height = textureheight[i] >> FRACBITS;
+
+        if (!texturepresent[i])
+            continue;
+
+        for (x = 0; x <= texturewidthmask[i]; x++)
+        {
+            const byte  *end;
+            const byte  *start = R_TextureColumnStart(i, x, &end);
+
+            stride = MAX(stride, R_TextureColumnSize(start, end, height));
+        }
+
+        textureatlasstride[i] = (stride + 3) & ~3;
+        size += textureatlasstride[i] * (texturewidthmask[i] + 1);
+    }
+
+    if (!(dest = textureatlas = malloc(size)))
+        I_Error("R_BuildTextureAtlas: Failure trying to allocate %u bytes", (unsigned int)size);
+
+    for (i = 0; i < numtextures; i++)
+    {
+        int     stride = textureatlasstride[i];
+        int     height = textureheight[i] >> FRACBITS;
+        byte    *columns = dest;
+
+        if (!texturepresent[i])
+            continue;
+
+        for (x = 0; x <= texturewidthmask[i]; x++, dest += stride)
+        {
+            const byte  *end;
+            const byte  *start = R_TextureColumnStart(i, x, &end);
+            int         length = MIN(R_TextureColumnSize(start, end, height), (int)(end - start));
+
+            memcpy(dest, start, length);
+            memset(dest + length, 0, stride - length);
+        }
+
+        textureatlascolumns[i] = columns + 3;
+    }
+}
+
+//
+// R_FreeTextureAtlas
+//
+static void R_FreeTextureAtlas(void)
+{
+    free(textureatlas);
+    textureatlas = NULL;
+    memset(textureatlascolumns, 0, numtextures * sizeof(*textureatlascolumns));
+}
+
 static void GenerateTextureHashTable(void)
 {
     texture_t   **rover;
@@ -595,6 +725,9 @@ static void R_InitTextures(void)
     texturewidthmask = Z_Malloc(numtextures * sizeof(*texturewidthmask), PU_STATIC, 0);
     textureheight = Z_Malloc(numtextures * sizeof(*textureheight), PU_STATIC, 0);
     texturefullbright = Z_Malloc(numtextures * sizeof(*texturefullbright), PU_STATIC, 0);
+    textureatlascolumns = Z_Malloc(numtextures * sizeof(*textureatlascolumns), PU_STATIC, 0);
+    textureatlasstride = Z_Malloc(numtextures * sizeof(*textureatlasstride), PU_STATIC, 0);
+    memset(textureatlascolumns, 0, numtextures * sizeof(*textureatlascolumns));
 
     totalwidth = 0;
 
@@ -984,6 +1117,10 @@ void R_PrecacheLevel(void)
         }
     }
 
+    R_FreeTextureAtlas();
+    if (M_CheckParm("-textureatlas"))
+        R_BuildTextureAtlas(texturepresent);
+
     Z_Free(texturepresent);
 
     // Precache sprites.
@@ -1009,7 +1146,7 @@ void R_PrecacheLevel(void)
             {
                 lump = firstspritelump + sf->lump[k];
                 spritememory += lumpinfo[lump].size;
-                W_CacheLumpNum(lump, PU_CACHE);
+                R_CacheSpritePatch(sf->lump[k]);
             }
         }
     }
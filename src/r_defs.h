@@ -545,6 +545,24 @@ typedef struct
     sector_t            *backsector;
 } seg_t;
 
+//
+// Packed copy of what the renderer reads from each seg, built
+// once a level is loaded. Sectors are referred to by index into sectors[],
+// so this stays valid however they move.
+//
+typedef struct
+{
+    fixed_t             x1, y1;
+    fixed_t             x2, y2;
+
+    int                 backsector;     // -1 for one sided lines
+
+    angle_t             normalangle;    // seg_t.angle + ANG90
+
+    // Light level change for horizontal (-) and vertical (+) lines.
+    int                 fakecontrast;
+} rendseg_t;
+
 //
 // BSP node.
 //
@@ -563,6 +581,30 @@ typedef struct
     int                 children[2];
 } node_t;
 
+//
+// Packed copy of a node for the renderer's BSP traversal, built once
+// a level is loaded. The bbox corner angles depend only on the view's
+// position, so they are kept and reused until anglestamp goes stale.
+//
+typedef struct
+{
+    // Partition line.
+    fixed_t             x, y;
+    fixed_t             dx, dy;
+
+    int                 children[2];
+
+    // Bounding box for each child.
+    fixed_t             bbox[2][4];
+
+    // Box position relative to the view, and the angles to the two corners
+    // that bound it, for each child.
+    unsigned int        anglestamp[2];
+    int                 boxpos[2];
+    angle_t             angle1[2];
+    angle_t             angle2[2];
+} rendnode_t;
+
 #ifdef _MSC_VER
 #pragma pack(push)
 #pragma pack(1)
@@ -582,6 +624,30 @@ typedef struct
 // column_t is a list of 0 or more post_t, (byte)-1 terminated
 typedef post_t column_t;
 
+//
+// A sprite's patch decoded once by R_CacheSpritePatch(), so drawing it
+// doesn't need to parse post headers. Each column is a list of its opaque
+// posts, with the pixels of each starting on a 4-byte boundary.
+//
+typedef struct
+{
+    int                 topdelta;
+    int                 length;
+    byte                *pixels;
+} rpost_t;
+
+typedef struct
+{
+    int                 numposts;
+    rpost_t             *posts;
+} rcolumn_t;
+
+typedef struct
+{
+    int                 width;
+    rcolumn_t           *columns;
+} rpatch_t;
+
 //
 // OTHER TYPES
 //
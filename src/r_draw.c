@@ -30,6 +30,10 @@
 #include "w_wad.h"
 #include "z_zone.h"
 
+#if defined(USE_SSE2)
+#include <emmintrin.h>
+#endif
+
 //
 // All drawing to the view buffer is accomplished in this file.
 // The other refresh files only know about ccordinates,
@@ -153,6 +157,19 @@ void R_DrawColumn(void)
     *dest = colormap[source[frac >> FRACBITS]];
 }
 
+//
+// Wall columns are drawn at wallbase + x * wallxpitch + y * wallypitch.
+// That's the screen, unless -transpose is used, in which case it's a
+// column-major buffer so each column is contiguous in memory, that
+// transposefunc copies to the screen once all the walls are drawn.
+//
+boolean         transposewalls;
+
+static byte     transposedwalls[SCREENWIDTH * SCREENHEIGHT];
+static byte     *wallbase;
+static int      wallxpitch;
+static int      wallypitch;
+
 #define HEIGHTMASK ((127 << FRACBITS) | 0xffff)
 
 void R_DrawWallColumn(void)
@@ -161,11 +178,12 @@ void R_DrawWallColumn(void)
     byte                *dest;
     fixed_t             frac;
     const fixed_t       fracstep = dc_iscale;
+    const int           pitch = wallypitch;
 
     if (count++ < 0)
         return;
 
-    dest = ylookup[dc_yl] + dc_x + viewwindowx;
+    dest = wallbase + dc_x * wallxpitch + dc_yl * pitch;
 
     frac = dc_texturemid + (dc_yl - centery) * fracstep;
 
@@ -178,11 +196,11 @@ void R_DrawWallColumn(void)
             while (--count)
             {
                 *dest = colormap[source[(frac & HEIGHTMASK) >> FRACBITS]];
-                dest += SCREENWIDTH;
+                dest += pitch;
                 frac += fracstep;
             }
             if (dc_bottomsparkle && !((frac >> FRACBITS) & 2))
-                *dest = *(dest - SCREENWIDTH);
+                *dest = *(dest - pitch);
             else
                 *dest = colormap[source[(frac & HEIGHTMASK) >> FRACBITS]];
         }
@@ -197,21 +215,21 @@ void R_DrawWallColumn(void)
                 while ((count -= 2) >= 0)
                 {
                     *dest = colormap[source[(frac & _heightmask) >> FRACBITS]];
-                    dest += SCREENWIDTH;
+                    dest += pitch;
                     frac += fracstep;
                     *dest = colormap[source[(frac & _heightmask) >> FRACBITS]];
-                    dest += SCREENWIDTH;
+                    dest += pitch;
                     frac += fracstep;
                 }
                 if (count & 1)
                 {
                     if (dc_bottomsparkle && !((frac >> FRACBITS) & 1))
-                        *dest = *(dest - SCREENWIDTH);
+                        *dest = *(dest - pitch);
                     else
                         *dest = colormap[source[(frac & _heightmask) >> FRACBITS]];
                 }
                 else if (dc_bottomsparkle && !(((frac - fracstep) >> FRACBITS) & 1))
-                    *(dest - SCREENWIDTH) = *(dest - (SCREENWIDTH << 1));
+                    *(dest - pitch) = *(dest - (pitch << 1));
             }
             else
             {
@@ -226,13 +244,13 @@ void R_DrawWallColumn(void)
                 while (--count)
                 {
                     *dest = colormap[source[frac >> FRACBITS]];
-                    dest += SCREENWIDTH;
+                    dest += pitch;
 
                     if ((frac += fracstep) >= (int32_t)heightmask)
                         frac -= heightmask;
                 }
                 if (dc_bottomsparkle && !((frac >> FRACBITS) & 1))
-                    *dest = *(dest - SCREENWIDTH);
+                    *dest = *(dest - pitch);
                 else
                     *dest = colormap[source[frac >> FRACBITS]];
             }
@@ -241,9 +259,201 @@ void R_DrawWallColumn(void)
 
     if (dc_topsparkle)
     {
-        dest = ylookup[dc_yl] + dc_x + viewwindowx;
-        *dest = *(dest + SCREENWIDTH);
+        dest = wallbase + dc_x * wallxpitch + dc_yl * pitch;
+        *dest = *(dest + pitch);
+    }
+}
+
+//
+// Wall columns with a power-of-two texture height are queued up in
+// batches of WALLBATCH adjacent columns per wall tier by R_QueueWallColumn(),
+// and drawn by R_FlushWallColumns() a row at a time over the rows they all
+// share, so each row's pixels go to the same cache line. The ragged ends
+// above and below that are drawn a column at a time.
+//
+#define WALLBATCH       4
+
+typedef struct
+{
+    int                 x;
+    int                 yl;
+    int                 yh;
+    fixed_t             frac;
+    fixed_t             fracstep;
+    fixed_t             heightmask;
+    const byte          *source;
+    const lighttable_t  *colormap;
+    int                 topsparkle;     // row to fix up, or -1
+    int                 bottomsparkle;  // row to fix up, or -1
+} wallcolumn_t;
+
+typedef struct
+{
+    int                 count;
+    wallcolumn_t        columns[WALLBATCH];
+} wallbatch_t;
+
+static wallbatch_t      wallbatches[NUMWALLTIERS];
+
+static void R_DrawWallColumnRows(wallcolumn_t *col, int count)
+{
+    byte                *dest = ylookup[col->yl] + col->x + viewwindowx;
+    fixed_t             frac = col->frac;
+    const fixed_t       fracstep = col->fracstep;
+    const fixed_t       heightmask = col->heightmask;
+    const byte          *source = col->source;
+    const lighttable_t  *colormap = col->colormap;
+
+    col->yl += count;
+
+    while (count-- > 0)
+    {
+        *dest = colormap[source[(frac & heightmask) >> FRACBITS]];
+        dest += SCREENWIDTH;
+        frac += fracstep;
+    }
+
+    col->frac = frac;
+}
+
+static void R_FlushWallBatch(wallbatch_t *batch)
+{
+    int                 count = batch->count;
+    wallcolumn_t        *columns = batch->columns;
+    int                 i;
+
+    if (!count)
+        return;
+
+    if (count == WALLBATCH)
+    {
+        int     top = columns[0].yl;
+        int     bottom = columns[0].yh;
+
+        for (i = 1; i < WALLBATCH; i++)
+        {
+            top = MAX(top, columns[i].yl);
+            bottom = MIN(bottom, columns[i].yh);
+        }
+
+        if (top <= bottom)
+        {
+            byte    *dest = ylookup[top] + columns[0].x + viewwindowx;
+            fixed_t frac[WALLBATCH];
+            int     y;
+
+            for (i = 0; i < WALLBATCH; i++)
+            {
+                R_DrawWallColumnRows(&columns[i], top - columns[i].yl);
+                frac[i] = columns[i].frac;
+            }
+
+            for (y = top; y <= bottom; y++)
+            {
+                for (i = 0; i < WALLBATCH; i++)
+                {
+                    const wallcolumn_t  *col = &columns[i];
+
+                    dest[i] = col->colormap[col->source[(frac[i] & col->heightmask) >> FRACBITS]];
+                    frac[i] += col->fracstep;
+                }
+                dest += SCREENWIDTH;
+            }
+
+            for (i = 0; i < WALLBATCH; i++)
+            {
+                columns[i].frac = frac[i];
+                columns[i].yl = bottom + 1;
+            }
+        }
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        wallcolumn_t    *col = &columns[i];
+        byte            *dest;
+
+        R_DrawWallColumnRows(col, col->yh - col->yl + 1);
+
+        if (col->bottomsparkle >= 0)
+        {
+            dest = ylookup[col->bottomsparkle] + col->x + viewwindowx;
+            *dest = *(dest - SCREENWIDTH);
+        }
+
+        if (col->topsparkle >= 0)
+        {
+            dest = ylookup[col->topsparkle] + col->x + viewwindowx;
+            *dest = *(dest + SCREENWIDTH);
+        }
+    }
+
+    batch->count = 0;
+}
+
+//
+// R_QueueWallColumn
+// Queues the column set up in the dc_* variables as the given wall tier,
+// drawing it straight away if its texture height isn't a power of two.
+//
+void R_QueueWallColumn(int tier)
+{
+    wallbatch_t         *batch = &wallbatches[tier];
+    wallcolumn_t        *col;
+    uint32_t            heightmask = dc_texheight - 1;
+    fixed_t             lastfrac;
+
+    if (dc_yh < dc_yl)
+        return;
+
+    // columns are already contiguous when transposed
+    if (transposewalls)
+    {
+        wallcolfunc();
+        return;
     }
+
+    if (dc_texheight & heightmask)
+    {
+        R_FlushWallBatch(batch);
+        wallcolfunc();
+        return;
+    }
+
+    if (batch->count && batch->columns[batch->count - 1].x != dc_x - 1)
+        R_FlushWallBatch(batch);
+
+    col = &batch->columns[batch->count++];
+    col->x = dc_x;
+    col->yl = dc_yl;
+    col->yh = dc_yh;
+    col->fracstep = dc_iscale;
+    col->frac = dc_texturemid + (dc_yl - centery) * dc_iscale;
+    col->heightmask = (heightmask << FRACBITS) | 0xffff;
+    col->source = dc_source;
+    col->colormap = dc_colormap;
+    col->topsparkle = (dc_topsparkle ? dc_yl : -1);
+
+    // the last pixel repeats the one above it on alternate texels, as
+    // R_DrawWallColumn() does
+    lastfrac = col->frac + (dc_yh - dc_yl) * dc_iscale;
+    col->bottomsparkle = (dc_bottomsparkle
+        && !((lastfrac >> FRACBITS) & (dc_texheight == 128 ? 2 : 1)) ? dc_yh : -1);
+
+    if (batch->count == WALLBATCH)
+        R_FlushWallBatch(batch);
+}
+
+//
+// R_FlushWallColumns
+// Draws any wall columns still queued up.
+//
+void R_FlushWallColumns(void)
+{
+    int i;
+
+    for (i = 0; i < NUMWALLTIERS; i++)
+        R_FlushWallBatch(&wallbatches[i]);
 }
 
 void R_DrawFullbrightWallColumn(byte *colormask)
@@ -252,11 +462,12 @@ void R_DrawFullbrightWallColumn(byte *colormask)
     byte                *dest;
     fixed_t             frac;
     const fixed_t       fracstep = dc_iscale;
+    const int           pitch = wallypitch;
 
     if (count++ < 0)
         return;
 
-    dest = ylookup[dc_yl] + dc_x + viewwindowx;
+    dest = wallbase + dc_x * wallxpitch + dc_yl * pitch;
 
     frac = dc_texturemid + (dc_yl - centery) * fracstep;
 
@@ -271,11 +482,11 @@ void R_DrawFullbrightWallColumn(byte *colormask)
                 byte dot = source[(frac & HEIGHTMASK) >> FRACBITS];
 
                 *dest = (colormask[dot] ? dot : colormap[dot]);
-                dest += SCREENWIDTH;
+                dest += pitch;
                 frac += fracstep;
             }
             if (dc_bottomsparkle && !((frac >> FRACBITS) & 2))
-                *dest = *(dest - SCREENWIDTH);
+                *dest = *(dest - pitch);
             else
             {
                 byte    dot = source[(frac & HEIGHTMASK) >> FRACBITS];
@@ -296,17 +507,17 @@ void R_DrawFullbrightWallColumn(byte *colormask)
                     byte        dot = source[(frac & _heightmask) >> FRACBITS];
 
                     *dest = (colormask[dot] ? dot : colormap[dot]);
-                    dest += SCREENWIDTH;
+                    dest += pitch;
                     frac += fracstep;
                     dot = source[(frac & _heightmask) >> FRACBITS];
                     *dest = (colormask[dot] ? dot : colormap[dot]);
-                    dest += SCREENWIDTH;
+                    dest += pitch;
                     frac += fracstep;
                 }
                 if (count & 1)
                 {
                     if (dc_bottomsparkle && !((frac >> FRACBITS) & 1))
-                        *dest = *(dest - SCREENWIDTH);
+                        *dest = *(dest - pitch);
                     else
                     {
                         byte    dot = source[(frac & _heightmask) >> FRACBITS];
@@ -315,7 +526,7 @@ void R_DrawFullbrightWallColumn(byte *colormask)
                     }
                 }
                 else if (dc_bottomsparkle && !(((frac - fracstep) >> FRACBITS) & 1))
-                    *(dest - SCREENWIDTH) = *(dest - (SCREENWIDTH << 1));
+                    *(dest - pitch) = *(dest - (pitch << 1));
             }
             else
             {
@@ -332,13 +543,13 @@ void R_DrawFullbrightWallColumn(byte *colormask)
                     byte        dot = source[frac >> FRACBITS];
 
                     *dest = (colormask[dot] ? dot : colormap[dot]);
-                    dest += SCREENWIDTH;
+                    dest += pitch;
 
                     if ((frac += fracstep) >= (int32_t)heightmask)
                         frac -= heightmask;
                 }
                 if (dc_bottomsparkle && !((frac >> FRACBITS) & 1))
-                    *dest = *(dest - SCREENWIDTH);
+                    *dest = *(dest - pitch);
                 else
                 {
                     byte        dot = source[frac >> FRACBITS];
@@ -351,8 +562,8 @@ void R_DrawFullbrightWallColumn(byte *colormask)
 
     if (dc_topsparkle)
     {
-        dest = ylookup[dc_yl] + dc_x + viewwindowx;
-        *dest = *(dest + SCREENWIDTH);
+        dest = wallbase + dc_x * wallxpitch + dc_yl * pitch;
+        *dest = *(dest + pitch);
     }
 }
 
@@ -455,35 +666,39 @@ void R_DrawFlippedSkyColumn(void)
     }
 }
 
-void R_DrawRedToBlueColumn(void)
+//
+// R_DrawSkyBufferColumn
+// Copies rows dc_yl to dc_yh of a column of the prebuilt sky in
+// dc_source, which is already scaled and lit, so there's nothing to map.
+//
+void R_DrawSkyBufferColumn(void)
 {
-    int32_t             count = dc_yh - dc_yl;
+    int32_t             count = dc_yh - dc_yl + 1;
     byte                *dest;
-    fixed_t             frac;
-    const fixed_t       fracstep = dc_iscale;
+    const byte          *source = dc_source + dc_yl;
 
-    if (count++ < 0)
+    if (count <= 0)
         return;
 
     dest = ylookup[dc_yl] + dc_x + viewwindowx;
 
-    frac = dc_texturefrac;
-
+    while (count--)
     {
-        const byte              *source = dc_source;
-        const lighttable_t      *colormap = dc_colormap;
-
-        while (--count)
-        {
-            *dest = colormap[redtoblue[source[frac >> FRACBITS]]];
-            dest += SCREENWIDTH;
-            frac += fracstep;
-        }
-        *dest = colormap[redtoblue[source[frac >> FRACBITS]]];
+        *dest = *source++;
+        dest += SCREENWIDTH;
     }
 }
 
-void R_DrawTranslucentRedToBlue33Column(void)
+//
+// R_DrawBlendedColumn
+// The column drawer all of the translated and translucent ones below are
+// made from. Each texel is remapped through translation if there is one,
+// then blended with what's already on screen through tint if there is one,
+// either after (colormapfirst) or before the colormap is applied. The
+// callers pass constant tables and flags, so each becomes its own loop.
+//
+static __inline void R_DrawBlendedColumn(const byte *tint, const byte *translation,
+    boolean colormapfirst)
 {
     int32_t             count = dc_yh - dc_yl;
     byte                *dest;
@@ -501,129 +716,54 @@ void R_DrawTranslucentRedToBlue33Column(void)
         const byte              *source = dc_source;
         const lighttable_t      *colormap = dc_colormap;
 
-        while (--count)
+        do
         {
-            *dest = tinttab33[(*dest << 8) + colormap[redtoblue[source[frac >> FRACBITS]]]];
-            dest += SCREENWIDTH;
-            frac += fracstep;
-        }
-        *dest = tinttab33[(*dest << 8) + colormap[redtoblue[source[frac >> FRACBITS]]]];
-    }
-}
+            byte        dot = source[frac >> FRACBITS];
 
-void R_DrawRedToGreenColumn(void)
-{
-    int32_t             count = dc_yh - dc_yl;
-    byte                *dest;
-    fixed_t             frac;
-    const fixed_t       fracstep = dc_iscale;
+            if (translation)
+                dot = translation[dot];
 
-    if (count++ < 0)
-        return;
-
-    dest = ylookup[dc_yl] + dc_x + viewwindowx;
-
-    frac = dc_texturefrac;
-
-    {
-        const byte              *source = dc_source;
-        const lighttable_t      *colormap = dc_colormap;
+            if (!tint)
+                *dest = colormap[dot];
+            else if (colormapfirst)
+                *dest = tint[(*dest << 8) + colormap[dot]];
+            else
+                *dest = colormap[tint[(*dest << 8) + dot]];
 
-        while (--count)
-        {
-            *dest = colormap[redtogreen[source[frac >> FRACBITS]]];
             dest += SCREENWIDTH;
             frac += fracstep;
-        }
-        *dest = colormap[redtogreen[source[frac >> FRACBITS]]];
+        } while (--count);
     }
 }
 
-void R_DrawTranslucentRedToGreen33Column(void)
+void R_DrawRedToBlueColumn(void)
 {
-    int32_t             count = dc_yh - dc_yl;
-    byte                *dest;
-    fixed_t             frac;
-    const fixed_t       fracstep = dc_iscale;
-
-    if (count++ < 0)
-        return;
-
-    dest = ylookup[dc_yl] + dc_x + viewwindowx;
+    R_DrawBlendedColumn(NULL, redtoblue, true);
+}
 
-    frac = dc_texturefrac;
+void R_DrawTranslucentRedToBlue33Column(void)
+{
+    R_DrawBlendedColumn(tinttab33, redtoblue, true);
+}
 
-    {
-        const byte              *source = dc_source;
-        const lighttable_t      *colormap = dc_colormap;
+void R_DrawRedToGreenColumn(void)
+{
+    R_DrawBlendedColumn(NULL, redtogreen, true);
+}
 
-        while (--count)
-        {
-            *dest = tinttab33[(*dest << 8) + colormap[redtogreen[source[frac >> FRACBITS]]]];
-            dest += SCREENWIDTH;
-            frac += fracstep;
-        }
-        *dest = tinttab33[(*dest << 8) + colormap[redtogreen[source[frac >> FRACBITS]]]];
-    }
+void R_DrawTranslucentRedToGreen33Column(void)
+{
+    R_DrawBlendedColumn(tinttab33, redtogreen, true);
 }
 
 void R_DrawTranslucentColumn(void)
 {
-    int32_t             count = dc_yh - dc_yl;
-    byte                *dest;
-    fixed_t             frac;
-    const fixed_t       fracstep = dc_iscale;
-
-    if (count++ < 0)
-        return;
-
-    dest = ylookup[dc_yl] + dc_x + viewwindowx;
-
-    frac = dc_texturefrac;
-
-    {
-        const byte              *source = dc_source;
-        const lighttable_t      *colormap = dc_colormap;
-
-        while (--count)
-        {
-            *dest = tinttab[(*dest << 8) + colormap[source[frac >> FRACBITS]]];
-            dest += SCREENWIDTH;
-            frac += fracstep;
-        }
-        *dest = tinttab[(*dest << 8) + colormap[source[frac >> FRACBITS]]];
-    }
+    R_DrawBlendedColumn(tinttab, NULL, true);
 }
 
 void R_DrawTranslucent50Column(void)
 {
-    int32_t             count = dc_yh - dc_yl;
-    byte                *dest;
-    fixed_t             frac;
-    const fixed_t       fracstep = dc_iscale;
-
-    if (count++ < 0)
-        return;
-
-    dest = ylookup[dc_yl] + dc_x + viewwindowx;
-
-    frac = dc_texturefrac;
-
-    {
-        byte                    dot;
-        const byte              *source = dc_source;
-        const lighttable_t      *colormap = dc_colormap;
-
-        while (--count)
-        {
-            dot = source[frac >> FRACBITS];
-            *dest = tinttab50[(*dest << 8) + colormap[dot]];
-            dest += SCREENWIDTH;
-            frac += fracstep;
-        }
-        dot = source[frac >> FRACBITS];
-        *dest = tinttab50[(*dest << 8) + colormap[dot]];
-    }
+    R_DrawBlendedColumn(tinttab50, NULL, true);
 }
 
 extern boolean megasphere;
@@ -665,226 +805,42 @@ void R_DrawTranslucent33Column(void)
 
 void R_DrawTranslucentRedColumn(void)
 {
-    int32_t             count = dc_yh - dc_yl;
-    byte                *dest;
-    fixed_t             frac;
-    const fixed_t       fracstep = dc_iscale;
-
-    if (count++ < 0)
-        return;
-
-    dest = ylookup[dc_yl] + dc_x + viewwindowx;
-
-    frac = dc_texturefrac;
-
-    {
-        const byte              *source = dc_source;
-        const lighttable_t      *colormap = dc_colormap;
-
-        while (--count)
-        {
-            *dest = tinttabred[(*dest << 8) + colormap[source[frac >> FRACBITS]]];
-            dest += SCREENWIDTH;
-            frac += fracstep;
-        }
-        *dest = tinttabred[(*dest << 8) + colormap[source[frac >> FRACBITS]]];
-    }
+    R_DrawBlendedColumn(tinttabred, NULL, true);
 }
 
 void R_DrawTranslucentRedWhiteColumn(void)
 {
-    int32_t             count = dc_yh - dc_yl;
-    byte                *dest;
-    fixed_t             frac;
-    const fixed_t       fracstep = dc_iscale;
-
-    if (count++ < 0)
-        return;
-
-    dest = ylookup[dc_yl] + dc_x + viewwindowx;
-
-    frac = dc_texturefrac;
-
-    {
-        const byte              *source = dc_source;
-        const lighttable_t      *colormap = dc_colormap;
-
-        while (--count)
-        {
-            *dest = colormap[tinttabredwhite[(*dest << 8) + source[frac >> FRACBITS]]];
-            dest += SCREENWIDTH;
-            frac += fracstep;
-        }
-        *dest = colormap[tinttabredwhite[(*dest << 8) + source[frac >> FRACBITS]]];
-    }
+    R_DrawBlendedColumn(tinttabredwhite, NULL, false);
 }
 
 void R_DrawTranslucentRedWhite50Column(void)
 {
-    int32_t             count = dc_yh - dc_yl;
-    byte                *dest;
-    fixed_t             frac;
-    const fixed_t       fracstep = dc_iscale;
-
-    if (count++ < 0)
-        return;
-
-    dest = ylookup[dc_yl] + dc_x + viewwindowx;
-
-    frac = dc_texturefrac;
-
-    {
-        const byte              *source = dc_source;
-        const lighttable_t      *colormap = dc_colormap;
-
-        while (--count)
-        {
-            *dest = colormap[tinttabredwhite50[(*dest << 8) + source[frac >> FRACBITS]]];
-            dest += SCREENWIDTH;
-            frac += fracstep;
-        }
-        *dest = colormap[tinttabredwhite50[(*dest << 8) + source[frac >> FRACBITS]]];
-    }
+    R_DrawBlendedColumn(tinttabredwhite50, NULL, false);
 }
 
 void R_DrawTranslucentGreenColumn(void)
 {
-    int32_t             count = dc_yh - dc_yl;
-    byte                *dest;
-    fixed_t             frac;
-    const fixed_t       fracstep = dc_iscale;
-
-    if (count++ < 0)
-        return;
-
-    dest = ylookup[dc_yl] + dc_x + viewwindowx;
-
-    frac = dc_texturefrac;
-
-    {
-        const byte              *source = dc_source;
-        const lighttable_t      *colormap = dc_colormap;
-
-        while (--count)
-        {
-            *dest = tinttabgreen[(*dest << 8) + colormap[source[frac >> FRACBITS]]];
-            dest += SCREENWIDTH;
-            frac += fracstep;
-        }
-        *dest = tinttabgreen[(*dest << 8) + colormap[source[frac >> FRACBITS]]];
-    }
+    R_DrawBlendedColumn(tinttabgreen, NULL, true);
 }
 
 void R_DrawTranslucentBlueColumn(void)
 {
-    int32_t             count = dc_yh - dc_yl;
-    byte                *dest;
-    fixed_t             frac;
-    const fixed_t       fracstep = dc_iscale;
-
-    if (count++ < 0)
-        return;
-
-    dest = ylookup[dc_yl] + dc_x + viewwindowx;
-
-    frac = dc_texturefrac;
-
-    {
-        const byte              *source = dc_source;
-        const lighttable_t      *colormap = dc_colormap;
-
-        while (--count)
-        {
-            *dest = tinttabblue[(*dest << 8) + colormap[source[frac >> FRACBITS]]];
-            dest += SCREENWIDTH;
-            frac += fracstep;
-        }
-        *dest = tinttabblue[(*dest << 8) + colormap[source[frac >> FRACBITS]]];
-    }
+    R_DrawBlendedColumn(tinttabblue, NULL, true);
 }
 
 void R_DrawTranslucentRed50Column(void)
 {
-    int32_t             count = dc_yh - dc_yl;
-    byte                *dest;
-    fixed_t             frac;
-    const fixed_t       fracstep = dc_iscale;
-
-    if (count++ < 0)
-        return;
-
-    dest = ylookup[dc_yl] + dc_x + viewwindowx;
-
-    frac = dc_texturefrac;
-
-    {
-        const byte              *source = dc_source;
-        const lighttable_t      *colormap = dc_colormap;
-
-        while (--count)
-        {
-            *dest = colormap[tinttabred50[(*dest << 8) + source[frac >> FRACBITS]]];
-            dest += SCREENWIDTH;
-            frac += fracstep;
-        }
-        *dest = colormap[tinttabred50[(*dest << 8) + source[frac >> FRACBITS]]];
-    }
+    R_DrawBlendedColumn(tinttabred50, NULL, false);
 }
 
 void R_DrawTranslucentGreen50Column(void)
 {
-    int32_t             count = dc_yh - dc_yl;
-    byte                *dest;
-    fixed_t             frac;
-    const fixed_t       fracstep = dc_iscale;
-
-    if (count++ < 0)
-        return;
-
-    dest = ylookup[dc_yl] + dc_x + viewwindowx;
-
-    frac = dc_texturefrac;
-
-    {
-        const byte              *source = dc_source;
-        const lighttable_t      *colormap = dc_colormap;
-
-        while (--count)
-        {
-            *dest = colormap[tinttabgreen50[(*dest << 8) + source[frac >> FRACBITS]]];
-            dest += SCREENWIDTH;
-            frac += fracstep;
-        }
-        *dest = colormap[tinttabgreen50[(*dest << 8) + source[frac >> FRACBITS]]];
-    }
+    R_DrawBlendedColumn(tinttabgreen50, NULL, false);
 }
 
 void R_DrawTranslucentBlue50Column(void)
 {
-    int32_t             count = dc_yh - dc_yl;
-    byte                *dest;
-    fixed_t             frac;
-    const fixed_t       fracstep = dc_iscale;
-
-    if (count++ < 0)
-        return;
-
-    dest = ylookup[dc_yl] + dc_x + viewwindowx;
-
-    frac = dc_texturefrac;
-
-    {
-        const byte              *source = dc_source;
-        const lighttable_t      *colormap = dc_colormap;
-
-        while (--count)
-        {
-            *dest = colormap[tinttabblue50[(*dest << 8) + source[frac >> FRACBITS]]];
-            dest += SCREENWIDTH;
-            frac += fracstep;
-        }
-        *dest = colormap[tinttabblue50[(*dest << 8) + source[frac >> FRACBITS]]];
-    }
+    R_DrawBlendedColumn(tinttabblue50, NULL, false);
 }
 
 //
@@ -1068,6 +1024,74 @@ void R_DrawSpan(void)
     *dest = colormap[source[((yfrac >> 10) & 4032) | ((xfrac >> 16) & 63)]];
 }
 
+#if defined(USE_SSE2)
+//
+// R_DrawSpanSSE2
+// Works out the flat offsets of 8 pixels at a time, 4 to a register, and
+// otherwise does exactly what R_DrawSpan() does.
+//
+void R_DrawSpanSSE2(void)
+{
+    unsigned int        count = ds_x2 - ds_x1 + 1;
+    byte                *dest = ylookup[ds_y] + ds_x1 + viewwindowx;
+    fixed_t             xfrac = ds_xfrac;
+    fixed_t             yfrac = ds_yfrac;
+    const fixed_t       xstep = ds_xstep;
+    const fixed_t       ystep = ds_ystep;
+    const byte          *source = ds_source;
+    const lighttable_t  *colormap = ds_colormap;
+
+    if (count >= 8)
+    {
+        __m128i         xfrac4 = _mm_setr_epi32(xfrac, xfrac + xstep, xfrac + xstep * 2,
+                            xfrac + xstep * 3);
+        __m128i         yfrac4 = _mm_setr_epi32(yfrac, yfrac + ystep, yfrac + ystep * 2,
+                            yfrac + ystep * 3);
+        const __m128i   xstep4 = _mm_set1_epi32(xstep * 4);
+        const __m128i   ystep4 = _mm_set1_epi32(ystep * 4);
+        const __m128i   xmask = _mm_set1_epi32(63);
+        const __m128i   ymask = _mm_set1_epi32(4032);
+        uint16_t        spot[8];
+
+        do
+        {
+            __m128i     spot1 = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(yfrac4, 10), ymask),
+                            _mm_and_si128(_mm_srli_epi32(xfrac4, 16), xmask));
+            __m128i     spot2;
+
+            xfrac4 = _mm_add_epi32(xfrac4, xstep4);
+            yfrac4 = _mm_add_epi32(yfrac4, ystep4);
+            spot2 = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(yfrac4, 10), ymask),
+                _mm_and_si128(_mm_srli_epi32(xfrac4, 16), xmask));
+            xfrac4 = _mm_add_epi32(xfrac4, xstep4);
+            yfrac4 = _mm_add_epi32(yfrac4, ystep4);
+
+            _mm_storeu_si128((__m128i *)spot, _mm_packs_epi32(spot1, spot2));
+
+            dest[0] = colormap[source[spot[0]]];
+            dest[1] = colormap[source[spot[1]]];
+            dest[2] = colormap[source[spot[2]]];
+            dest[3] = colormap[source[spot[3]]];
+            dest[4] = colormap[source[spot[4]]];
+            dest[5] = colormap[source[spot[5]]];
+            dest[6] = colormap[source[spot[6]]];
+            dest[7] = colormap[source[spot[7]]];
+            dest += 8;
+        } while ((count -= 8) >= 8);
+
+        xfrac = _mm_cvtsi128_si32(xfrac4);
+        yfrac = _mm_cvtsi128_si32(yfrac4);
+    }
+
+    while (count--)
+    {
+        *dest++ = colormap[source[((yfrac >> 10) & 4032) | ((xfrac >> 16) & 63)]];
+        xfrac += xstep;
+        yfrac += ystep;
+    }
+}
+#endif
+
 //
 // R_InitBuffer
 // Creates lookup tables that avoid
@@ -1096,7 +1120,132 @@ void R_InitBuffer(int width, int height)
         ylookup[i] = screens[0] + (i + viewwindowy) * SCREENWIDTH;
         ylookup2[i] = screens[1] + (i + viewwindowy) * SCREENWIDTH;
     }
+
+    if (transposewalls)
+    {
+        wallbase = transposedwalls;
+        wallxpitch = SCREENHEIGHT;
+        wallypitch = 1;
+    }
+    else
+    {
+        wallbase = ylookup[0] + viewwindowx;
+        wallxpitch = 1;
+        wallypitch = SCREENWIDTH;
+    }
+}
+
+//
+// R_ClearTransposedWalls
+// Fills the part of the transposed wall buffer in use with color.
+//
+void R_ClearTransposedWalls(byte color)
+{
+    memset(transposedwalls, color, viewwidth * SCREENHEIGHT);
+}
+
+//
+// R_TransposeBlock
+// Copies an 8x8 block from the transposed buffer to the screen.
+//
+static void R_TransposeBlock(const byte *src, byte *dest)
+{
+    int i, j;
+
+    for (i = 0; i < 8; i++, dest += SCREENWIDTH)
+        for (j = 0; j < 8; j++)
+            dest[j] = src[j * SCREENHEIGHT + i];
+}
+
+#if defined(USE_SSE2)
+//
+// R_TransposeBlockSSE2
+// The same, transposing the block in registers, one column per 8 bytes.
+//
+static void R_TransposeBlockSSE2(const byte *src, byte *dest)
+{
+    __m128i     a0 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)src),
+                    _mm_loadl_epi64((const __m128i *)(src + SCREENHEIGHT)));
+    __m128i     a1 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(src + SCREENHEIGHT * 2)),
+                    _mm_loadl_epi64((const __m128i *)(src + SCREENHEIGHT * 3)));
+    __m128i     a2 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(src + SCREENHEIGHT * 4)),
+                    _mm_loadl_epi64((const __m128i *)(src + SCREENHEIGHT * 5)));
+    __m128i     a3 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(src + SCREENHEIGHT * 6)),
+                    _mm_loadl_epi64((const __m128i *)(src + SCREENHEIGHT * 7)));
+    __m128i     b0 = _mm_unpacklo_epi16(a0, a1);
+    __m128i     b1 = _mm_unpackhi_epi16(a0, a1);
+    __m128i     b2 = _mm_unpacklo_epi16(a2, a3);
+    __m128i     b3 = _mm_unpackhi_epi16(a2, a3);
+    __m128i     rows[4];
+    int         i;
+
+    rows[0] = _mm_unpacklo_epi32(b0, b2);
+    rows[1] = _mm_unpackhi_epi32(b0, b2);
+    rows[2] = _mm_unpacklo_epi32(b1, b3);
+    rows[3] = _mm_unpackhi_epi32(b1, b3);
+
+    for (i = 0; i < 4; i++)
+    {
+        _mm_storel_epi64((__m128i *)dest, rows[i]);
+        dest += SCREENWIDTH;
+        _mm_storel_epi64((__m128i *)dest, _mm_unpackhi_epi64(rows[i], rows[i]));
+        dest += SCREENWIDTH;
+    }
+}
+#endif
+
+//
+// R_CopyTransposed
+// Copies the transposed wall buffer to the view window, in 8x8 blocks so
+// both the reads and the writes stay within a few cache lines at a time.
+// Each block is copied by transposeblock.
+//
+static __inline void R_CopyTransposed(void (*transposeblock)(const byte *, byte *))
+{
+    int x, y;
+
+    for (y = 0; y + 8 <= viewheight; y += 8)
+    {
+        for (x = 0; x + 8 <= viewwidth; x += 8)
+            transposeblock(transposedwalls + x * SCREENHEIGHT + y, ylookup[y] + viewwindowx + x);
+
+        // leftover columns on the right
+        for (; x < viewwidth; x++)
+        {
+            const byte  *src = transposedwalls + x * SCREENHEIGHT + y;
+            int         i;
+
+            for (i = 0; i < 8; i++)
+                ylookup[y + i][viewwindowx + x] = src[i];
+        }
+    }
+
+    // leftover rows at the bottom
+    for (; y < viewheight; y++)
+    {
+        byte    *dest = ylookup[y] + viewwindowx;
+
+        for (x = 0; x < viewwidth; x++)
+            dest[x] = transposedwalls[x * SCREENHEIGHT + y];
+    }
+}
+
+//
+// R_CopyTransposedWalls
+// R_CopyTransposedWallsSSE2
+// R_ExecuteSetViewSize() picks one of these as transposefunc.
+//
+void R_CopyTransposedWalls(void)
+{
+    R_CopyTransposed(R_TransposeBlock);
+}
+
+#if defined(USE_SSE2)
+void R_CopyTransposedWallsSSE2(void)
+{
+    R_CopyTransposed(R_TransposeBlockSSE2);
 }
+#endif
 
 //
 // R_FillBackScreen
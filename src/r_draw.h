@@ -26,6 +26,11 @@
 #ifndef __R_DRAW__
 #define __R_DRAW__
 
+// SSE2 versions of some drawers, picked at runtime if the CPU has it
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_IX86)
+#define USE_SSE2
+#endif
+
 extern lighttable_t     *dc_colormap;
 extern int              dc_x;
 extern int              dc_yl;
@@ -40,6 +45,15 @@ extern boolean          dc_bottomsparkle;
 // first pixel in a column
 extern byte             *dc_source;
 
+// wall tiers for R_QueueWallColumn()
+enum
+{
+    WALLTIER_TOP,
+    WALLTIER_MID,
+    WALLTIER_BOTTOM,
+    NUMWALLTIERS
+};
+
 extern byte             *tinttab;
 extern byte             *tinttab33;
 extern byte             *tinttab50;
@@ -58,8 +72,19 @@ extern byte             *tinttabblue50;
 void R_DrawColumn(void);
 void R_DrawWallColumn(void);
 void R_DrawFullbrightWallColumn(byte *);
+void R_QueueWallColumn(int tier);
+void R_FlushWallColumns(void);
+
+extern boolean          transposewalls;
+
+void R_ClearTransposedWalls(byte color);
+void R_CopyTransposedWalls(void);
+#if defined(USE_SSE2)
+void R_CopyTransposedWallsSSE2(void);
+#endif
 void R_DrawSkyColumn(void);
 void R_DrawFlippedSkyColumn(void);
+void R_DrawSkyBufferColumn(void);
 void R_DrawTranslucentColumn(void);
 void R_DrawTranslucent50Column(void);
 void R_DrawTranslucent33Column(void);
@@ -101,6 +126,9 @@ extern byte             *ds_source;
 // Span blitting for rows, floor/ceiling.
 // No Spectre effect needed.
 void R_DrawSpan(void);
+#if defined(USE_SSE2)
+void R_DrawSpanSSE2(void);
+#endif
 
 void R_InitBuffer(int width, int height);
 
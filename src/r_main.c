@@ -26,8 +26,11 @@
 #define _USE_MATH_DEFINES
 
 #include <math.h>
+#include <stdlib.h>
 
 #include "d_net.h"
+#include "i_system.h"
+#include "m_argv.h"
 #include "m_config.h"
 #include "m_menu.h"
 #include "r_local.h"
@@ -97,6 +100,7 @@ extern int              automapactive;
 extern int              viewheight2;
 extern int              gametic;
 extern boolean          canmodify;
+extern boolean          devparm;
 
 void (*colfunc)(void);
 void (*wallcolfunc)(void);
@@ -117,12 +121,34 @@ void (*tlblue50colfunc)(void);
 void (*redtobluecolfunc)(void);
 void (*transcolfunc)(void);
 void (*spanfunc)(void);
+void (*transposefunc)(void);
 void (*skycolfunc)(void);
 void (*redtogreencolfunc)(void);
 void (*tlredtoblue33colfunc)(void);
 void (*tlredtogreen33colfunc)(void);
 void (*psprcolfunc)(void);
 
+// per-frame render arena. Everything allocated from it is only valid
+//  until the next R_ClearFrameArena().
+#define FRAMEARENAALIGN         16
+#define FRAMEARENAMIN           (256 * 1024)
+
+typedef struct frameblock_s
+{
+    struct frameblock_s *next;
+    size_t              size;
+    size_t              used;
+} frameblock_t;
+
+#define FRAMEBLOCKHEADER        ((sizeof(frameblock_t) + FRAMEARENAALIGN - 1) & ~(FRAMEARENAALIGN - 1))
+
+static byte             *framearena;
+static size_t           framearenasize;
+static size_t           framearenaused;
+static frameblock_t     *frameoverflow;
+static size_t           framearenatotal;
+size_t                  framearenahighwater;
+
 //
 // R_PointOnSide
 // Traverse BSP (sub) tree,
@@ -497,7 +523,23 @@ void R_ExecuteSetViewSize(void)
         tlredtogreen33colfunc = R_DrawColumn;
     }
 
+    transposewalls = !!M_CheckParm("-transpose");
+
+#if defined(USE_SSE2)
+    if (I_HasSSE2() && !M_CheckParm("-nosimd"))
+    {
+        spanfunc = R_DrawSpanSSE2;
+        transposefunc = R_CopyTransposedWallsSSE2;
+    }
+    else
+    {
+        spanfunc = R_DrawSpan;
+        transposefunc = R_CopyTransposedWalls;
+    }
+#else
     spanfunc = R_DrawSpan;
+    transposefunc = R_CopyTransposedWalls;
+#endif
     redtobluecolfunc = R_DrawRedToBlueColumn;
     redtogreencolfunc = R_DrawRedToGreenColumn;
     wallcolfunc = R_DrawWallColumn;
@@ -548,6 +590,87 @@ void R_ExecuteSetViewSize(void)
     }
 }
 
+//
+// R_FrameAlloc
+// Returns size bytes from the frame arena. If the arena runs out
+// partway through a frame, more is taken in overflow blocks, each at least
+// twice the size of the last, so what was handed out never moves. The
+// arena is then grown to fit before the next frame.
+//
+void *R_FrameAlloc(size_t size)
+{
+    void        *ptr;
+
+    size = (size + FRAMEARENAALIGN - 1) & ~(FRAMEARENAALIGN - 1);
+    framearenatotal += size;
+
+    if (framearenaused + size <= framearenasize)
+    {
+        ptr = framearena + framearenaused;
+        framearenaused += size;
+        return ptr;
+    }
+
+    if (!frameoverflow || frameoverflow->used + size > frameoverflow->size)
+    {
+        size_t          blocksize = (frameoverflow ? frameoverflow->size * 2 : framearenasize);
+        frameblock_t    *block;
+
+        while (blocksize < size)
+            blocksize = (blocksize ? blocksize * 2 : FRAMEARENAMIN);
+        if (!(block = malloc(FRAMEBLOCKHEADER + blocksize)))
+            I_Error("R_FrameAlloc: failed on allocation of %u bytes", (unsigned int)blocksize);
+        block->next = frameoverflow;
+        block->size = blocksize;
+        block->used = 0;
+        frameoverflow = block;
+    }
+
+    ptr = (byte *)frameoverflow + FRAMEBLOCKHEADER + frameoverflow->used;
+    frameoverflow->used += size;
+    return ptr;
+}
+
+//
+// R_ClearFrameArena
+// Called at the start of every frame. Normally this just rewinds the
+// arena. If the last frame needed overflow blocks, they are freed and the
+// arena is reallocated big enough for everything that frame used.
+//
+void R_ClearFrameArena(void)
+{
+    if (framearenatotal > framearenahighwater)
+        framearenahighwater = framearenatotal;
+
+    if (frameoverflow || !framearena)
+    {
+        size_t  size = (framearenasize ? framearenasize : FRAMEARENAMIN);
+        boolean grown = !!frameoverflow;
+
+        while (frameoverflow)
+        {
+            frameblock_t        *next = frameoverflow->next;
+
+            free(frameoverflow);
+            frameoverflow = next;
+        }
+
+        while (size < framearenahighwater)
+            size *= 2;
+        free(framearena);
+        if (!(framearena = malloc(size)))
+            I_Error("R_ClearFrameArena: failed on allocation of %u bytes", (unsigned int)size);
+        framearenasize = size;
+
+        if (grown && devparm)
+            printf("R_ClearFrameArena: high-water mark %u bytes, arena now %u bytes\n",
+                (unsigned int)framearenahighwater, (unsigned int)framearenasize);
+    }
+
+    framearenaused = 0;
+    framearenatotal = 0;
+}
+
 //
 // R_Init
 //
@@ -622,6 +745,7 @@ void R_RenderPlayerView(player_t *player)
     R_SetupFrame(player);
 
     // Clear buffers.
+    R_ClearFrameArena();
     R_ClearClipSegs();
     R_ClearDrawSegs();
 
@@ -632,16 +756,24 @@ void R_RenderPlayerView(player_t *player)
     }
     else
     {
+        byte    homcolor = (homindicator && (gametic % 20) < 9
+                    && !(player->cheats & CF_NOCLIP) ? 176 : 0);
+
         // Clear buffers.
         R_ClearPlanes();
         R_ClearSprites();
 
-        V_FillRect(0, viewwindowx, viewwindowy, viewwidth, viewheight,
-            homindicator && (gametic % 20) < 9 && !(player->cheats & CF_NOCLIP) ? 176 : 0);
+        V_FillRect(0, viewwindowx, viewwindowy, viewwidth, viewheight, homcolor);
+
+        if (transposewalls)
+            R_ClearTransposedWalls(homcolor);
 
         // The head node is the last node output.
         R_RenderBSPNode(numnodes - 1);
 
+        if (transposewalls)
+            transposefunc();
+
         R_DrawPlanes();
         R_DrawMasked();
     }
@@ -107,6 +107,7 @@ extern void (*redtogreencolfunc)(void);
 extern void (*tlredtogreen33colfunc)(void);
 extern void (*psprcolfunc)(void);
 extern void (*spanfunc)(void);
+extern void (*transposefunc)(void);
 
 //
 // Utility functions.
@@ -129,6 +130,12 @@ subsector_t *R_PointInSubsector(fixed_t x, fixed_t y);
 // Called by G_Drawer.
 void R_RenderPlayerView(player_t *player);
 
+// Per-frame render scratch memory.
+extern size_t           framearenahighwater;
+
+void *R_FrameAlloc(size_t size);
+void R_ClearFrameArena(void);
+
 // Called by startup code.
 void R_Init(void);
 
@@ -33,8 +33,6 @@
 #define MAXVISPLANES    128                             // must be a power of 2
 
 static visplane_t       *visplanes[MAXVISPLANES];       // killough
-static visplane_t       *freetail;                      // killough
-static visplane_t       **freehead = &freetail;         // killough
 visplane_t              *floorplane;
 visplane_t              *ceilingplane;
 
@@ -43,10 +41,6 @@ visplane_t              *ceilingplane;
 #define visplane_hash(picnum, lightlevel, height) \
     (((unsigned int)(picnum) * 3 + (unsigned int)(lightlevel) + (unsigned int)(height) * 7) & (MAXVISPLANES - 1))
 
-size_t                 maxopenings;
-int                    *openings;                       // dropoff overflow
-int                    *lastopening;                    // dropoff overflow
-
 // Clip values are the solid pixel bounding the range.
 //  floorclip starts out SCREENHEIGHT
 //  ceilingclip starts out -1
@@ -64,6 +58,15 @@ static fixed_t          planeheight;
 fixed_t                 yslope[SCREENHEIGHT];
 fixed_t                 distscale[SCREENWIDTH];
 
+// the sky, already scaled to the view and lit, one column per texture
+//  column. Rebuilt whenever anything it was built from changes.
+static byte             *skybuffer;
+static int              skybuffertexture = -1;
+static int              skybufferheight;
+static int              skybuffercentery;
+static fixed_t          skybufferiscale;
+static boolean          skybufferflipped;
+
 //
 // R_MapPlane
 //
@@ -114,22 +117,15 @@ void R_ClearPlanes(void)
         ceilingclip[i] = -1;
     }
 
-    for (i = 0; i < MAXVISPLANES; i++)  // new code -- killough
-        for (*freehead = visplanes[i], visplanes[i] = NULL; *freehead;)
-            freehead = &(*freehead)->next;
-
-    lastopening = openings;
+    // visplanes come from the frame arena, so just forget them
+    memset(visplanes, 0, sizeof(visplanes));
 }
 
 // New function, by Lee Killough
 static visplane_t *new_visplane(unsigned hash)
 {
-    visplane_t  *check = freetail;
+    visplane_t  *check = R_FrameAlloc(sizeof(*check));
 
-    if (!check)
-        check = calloc(1, sizeof(*check));
-    else if (!(freetail = freetail->next))
-        freehead = &freetail;
     check->next = visplanes[hash];
     visplanes[hash] = check;
     return check;
@@ -238,6 +234,53 @@ static void R_MakeSpans(int x, int t1, int b1, int t2, int b2)
         spanstart[b2--] = x;
 }
 
+//
+// R_InitSkyBuffer
+// Renders every column of the sky texture into skybuffer, scaled to the
+// current view and lit through colormaps, the same as skycolfunc would draw
+// it. Does nothing if the sky, the view size or skycolfunc haven't changed
+// since the last time.
+//
+static void R_InitSkyBuffer(void)
+{
+    const boolean       flipped = (skycolfunc == R_DrawFlippedSkyColumn);
+    const int           heightmask = (textureheight[skytexture] >> FRACBITS) - 1;
+    int                 x;
+    byte                *dest;
+
+    if (skybuffer && skybuffertexture == skytexture && skybufferheight == viewheight
+        && skybuffercentery == centery && skybufferiscale == pspriteiscale
+        && skybufferflipped == flipped)
+        return;
+
+    if (skybuffer)
+        Z_Free(skybuffer);
+    skybuffer = Z_Malloc((texturewidthmask[skytexture] + 1) * viewheight, PU_STATIC, NULL);
+
+    dest = skybuffer;
+    for (x = 0; x <= texturewidthmask[skytexture]; x++)
+    {
+        const byte      *source = R_GetColumn(skytexture, x);
+        fixed_t         frac = skytexturemid - centery * pspriteiscale;
+        int             y;
+
+        for (y = 0; y < viewheight; y++)
+        {
+            int i = frac >> FRACBITS;
+
+            *dest++ = colormaps[source[flipped ? (i > 127 ? 126 - (i & 127) : i) :
+                (i & heightmask)]];
+            frac += pspriteiscale;
+        }
+    }
+
+    skybuffertexture = skytexture;
+    skybufferheight = viewheight;
+    skybuffercentery = centery;
+    skybufferiscale = pspriteiscale;
+    skybufferflipped = flipped;
+}
+
 //
 // R_DrawPlanes
 // At the end of each frame.
@@ -259,26 +302,47 @@ void R_DrawPlanes(void)
                 {
                     int x;
                     
-                    dc_iscale = pspriteiscale;
-
                     // Sky is always drawn full bright,
                     //  i.e. colormaps[0] is used.
                     // Because of this hack, sky is not affected
                     //  by INVUL inverse mapping.
-                    dc_colormap = (fixedcolormap ? fixedcolormap : colormaps);
-                    dc_texturemid = skytexturemid;
-                    dc_texheight = textureheight[skytexture] >> FRACBITS;
-                    for (x = pl->minx; x <= pl->maxx; x++)
+                    if (fixedcolormap)
+                    {
+                        dc_iscale = pspriteiscale;
+                        dc_colormap = fixedcolormap;
+                        dc_texturemid = skytexturemid;
+                        dc_texheight = textureheight[skytexture] >> FRACBITS;
+                        for (x = pl->minx; x <= pl->maxx; x++)
+                        {
+                            dc_yl = pl->top[x];
+                            dc_yh = pl->bottom[x];
+
+                            if (dc_yl != SHRT_MAX && dc_yl <= dc_yh)
+                            {
+                                dc_x = x;
+                                dc_source = R_GetColumn(skytexture,
+                                    (viewangle + xtoviewangle[x]) >> ANGLETOSKYSHIFT);
+                                skycolfunc();
+                            }
+                        }
+                    }
+                    else
                     {
-                        dc_yl = pl->top[x];
-                        dc_yh = pl->bottom[x];
+                        const int       widthmask = texturewidthmask[skytexture];
 
-                        if (dc_yl != SHRT_MAX && dc_yl <= dc_yh)
+                        R_InitSkyBuffer();
+                        for (x = pl->minx; x <= pl->maxx; x++)
                         {
-                            dc_x = x;
-                            dc_source = R_GetColumn(skytexture,
-                                (viewangle + xtoviewangle[x]) >> ANGLETOSKYSHIFT);
-                            skycolfunc();
+                            dc_yl = pl->top[x];
+                            dc_yh = pl->bottom[x];
+
+                            if (dc_yl != SHRT_MAX && dc_yl <= dc_yh)
+                            {
+                                dc_x = x;
+                                dc_source = skybuffer + skybufferheight
+                                    * (((viewangle + xtoviewangle[x]) >> ANGLETOSKYSHIFT) & widthmask);
+                                R_DrawSkyBufferColumn();
+                            }
                         }
                     }
                 }
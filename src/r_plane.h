@@ -29,8 +29,6 @@
 #include "r_data.h"
 
 // Visplane related.
-extern  int     *lastopening;
-
 extern int      floorclip[];
 extern int      ceilingclip[];
 
@@ -149,12 +149,7 @@ void R_RenderMaskedSegRange(drawseg_t *ds, int x1, int x2)
 
     lightnum = (frontsector->lightlevel >> LIGHTSEGSHIFT) + extralight * LIGHTBRIGHT;
     if (frontsector->ceilingpic != skyflatnum)
-    {
-        if (curline->v1->y == curline->v2->y)
-            lightnum -= LIGHTBRIGHT;
-        else if (curline->v1->x == curline->v2->x)
-            lightnum += LIGHTBRIGHT;
-    }
+        lightnum += rendsegs[curline - segs].fakecontrast;
 
     walllights = scalelight[BETWEEN(0, lightnum, LIGHTLEVELS - 1)];
 
@@ -301,7 +296,7 @@ void R_RenderSegLoop(void)
             if (brightmaps && texturefullbright[midtexture] && !fixedcolormap)
                 fbwallcolfunc(texturefullbright[midtexture]);
             else
-                wallcolfunc();
+                R_QueueWallColumn(WALLTIER_MID);
             ceilingclip[rw_x] = viewheight;
             floorclip[rw_x] = -1;
         }
@@ -334,7 +329,7 @@ void R_RenderSegLoop(void)
                     if (brightmaps && texturefullbright[toptexture] && !fixedcolormap)
                         fbwallcolfunc(texturefullbright[toptexture]);
                     else
-                        wallcolfunc();
+                        R_QueueWallColumn(WALLTIER_TOP);
                     ceilingclip[rw_x] = mid;
                 }
                 else
@@ -374,7 +369,7 @@ void R_RenderSegLoop(void)
                     if (brightmaps && texturefullbright[bottomtexture] && !fixedcolormap)
                         fbwallcolfunc(texturefullbright[bottomtexture]);
                     else
-                        wallcolfunc();
+                        R_QueueWallColumn(WALLTIER_BOTTOM);
                     floorclip[rw_x] = mid;
                 }
                 else
@@ -396,6 +391,8 @@ void R_RenderSegLoop(void)
         topfrac += topstep;
         bottomfrac += bottomstep;
     }
+
+    R_FlushWallColumns();
 }
 
 //
@@ -430,14 +427,14 @@ void R_StoreWallRange(int start, int stop)
     }
 
     // calculate rw_distance for scale calculation
-    rw_normalangle = curline->angle + ANG90;
+    rw_normalangle = currendseg->normalangle;
     offsetangle = rw_normalangle - rw_angle1;
 
     if (ABS(offsetangle) > ANG90)
         offsetangle = ANG90;
 
-    hyp = (viewx == curline->v1->x && viewy == curline->v1->y ? 0 :
-        R_PointToDist(curline->v1->x, curline->v1->y));
+    hyp = (viewx == currendseg->x1 && viewy == currendseg->y1 ? 0 :
+        R_PointToDist(currendseg->x1, currendseg->y1));
     rw_distance = FixedMul(hyp, finecosine[offsetangle >> ANGLETOFINESHIFT]);
 
     ds_p->x1 = rw_x = start;
@@ -445,43 +442,6 @@ void R_StoreWallRange(int start, int stop)
     ds_p->curline = curline;
     rw_stopx = stop + 1;
 
-    // killough 1/6/98, 2/1/98: remove limit on openings
-    {
-        extern int      *openings;
-        extern size_t   maxopenings;
-        size_t          pos = lastopening - openings;
-        size_t          need = (rw_stopx - start) * 4 + pos;
-
-        if (need > maxopenings)
-        {
-            drawseg_t   *ds;                    // jff 8/9/98 needed for fix from ZDoom
-            int         *oldopenings = openings;
-            int         *oldlast = lastopening;
-
-            do
-                maxopenings = (maxopenings ? maxopenings * 2 : 16384);
-            while (need > maxopenings);
-            openings = (int *)realloc(openings, maxopenings * sizeof(*openings));
-            lastopening = openings + pos;
-
-            // jff 8/9/98 borrowed fix for openings from ZDOOM1.14
-            // [RH] We also need to adjust the openings pointers that
-            //    were already stored in drawsegs.
-            for (ds = drawsegs; ds < ds_p; ds++)
-            {
-                if (ds->maskedtexturecol + ds->x1 >= oldopenings
-                    && ds->maskedtexturecol + ds->x1 <= oldlast)
-                    ds->maskedtexturecol = ds->maskedtexturecol - oldopenings + openings;
-                if (ds->sprtopclip + ds->x1 >= oldopenings
-                    && ds->sprtopclip + ds->x1 <= oldlast)
-                    ds->sprtopclip = ds->sprtopclip - oldopenings + openings;
-                if (ds->sprbottomclip + ds->x1 >= oldopenings
-                    && ds->sprbottomclip + ds->x1 <= oldlast)
-                    ds->sprbottomclip = ds->sprbottomclip - oldopenings + openings;
-            }
-        }
-    }
-
     // calculate scale at both ends and step
     ds_p->scale1 = rw_scale = R_ScaleFromGlobalAngle(viewangle + xtoviewangle[start]);
 
@@ -674,8 +634,8 @@ void R_StoreWallRange(int start, int stop)
         {
             // masked midtexture
             maskedtexture = true;
-            ds_p->maskedtexturecol = maskedtexturecol = lastopening - rw_x;
-            lastopening += rw_stopx - rw_x;
+            ds_p->maskedtexturecol = maskedtexturecol =
+                (int *)R_FrameAlloc((rw_stopx - rw_x) * sizeof(int)) - rw_x;
         }
     }
 
@@ -698,12 +658,7 @@ void R_StoreWallRange(int start, int stop)
             lightnum = (frontsector->lightlevel >> LIGHTSEGSHIFT) + extralight * LIGHTBRIGHT;
 
             if (frontsector->ceilingpic != skyflatnum)
-            {
-                if (curline->v1->y == curline->v2->y)
-                    lightnum -= LIGHTBRIGHT;
-                else if (curline->v1->x == curline->v2->x)
-                    lightnum += LIGHTBRIGHT;
-            }
+                lightnum += currendseg->fakecontrast;
 
             walllights = scalelight[BETWEEN(0, lightnum, LIGHTLEVELS - 1)];
         }
@@ -774,16 +729,14 @@ void R_StoreWallRange(int start, int stop)
     // save sprite clipping info
     if (((ds_p->silhouette & SIL_TOP) || maskedtexture) && !ds_p->sprtopclip)
     {
-        memcpy(lastopening, ceilingclip + start, sizeof(int) * (rw_stopx - start));
-        ds_p->sprtopclip = lastopening - start;
-        lastopening += rw_stopx - start;
+        ds_p->sprtopclip = (int *)R_FrameAlloc(sizeof(int) * (rw_stopx - start)) - start;
+        memcpy(ds_p->sprtopclip + start, ceilingclip + start, sizeof(int) * (rw_stopx - start));
     }
 
     if (((ds_p->silhouette & SIL_BOTTOM) || maskedtexture) && !ds_p->sprbottomclip)
     {
-        memcpy(lastopening, floorclip + start, sizeof(int) * (rw_stopx - start));
-        ds_p->sprbottomclip = lastopening - start;
-        lastopening += rw_stopx - start;
+        ds_p->sprbottomclip = (int *)R_FrameAlloc(sizeof(int) * (rw_stopx - start)) - start;
+        memcpy(ds_p->sprbottomclip + start, floorclip + start, sizeof(int) * (rw_stopx - start));
     }
 
     if (maskedtexture && !(ds_p->silhouette & SIL_TOP))
@@ -37,6 +37,7 @@
 
 // needed for texture pegging
 extern fixed_t          *textureheight;
+extern int              *texturewidthmask;
 
 extern byte             **texturefullbright;
 
@@ -264,6 +264,9 @@ void R_InitSpriteDefs(char **namelist)
 static vissprite_t      *vissprites, **vissprite_ptrs;          // killough
 static int              num_vissprite, num_vissprite_alloc, num_vissprite_ptrs;
 
+// decoded sprite patches, purged along with other cached data
+static rpatch_t         **spritepatches;
+
 //
 // R_InitSprites
 // Called at program start.
@@ -276,6 +279,79 @@ void R_InitSprites(char **namelist)
         negonearray[i] = -1;
 
     R_InitSpriteDefs(namelist);
+
+    spritepatches = Z_Malloc(numspritelumps * sizeof(*spritepatches), PU_STATIC, NULL);
+    memset(spritepatches, 0, numspritelumps * sizeof(*spritepatches));
+}
+
+//
+// R_CacheSpritePatch
+// Returns the decoded patch of a sprite lump, decoding it first if it hasn't
+// been yet or has since been purged.
+//
+rpatch_t *R_CacheSpritePatch(int lump)
+{
+    rpatch_t    *rpatch = spritepatches[lump];
+    patch_t     *patch;
+    int         width;
+    int         numposts = 0;
+    int         numpixels = 0;
+    rcolumn_t   *rcolumn;
+    rpost_t     *rpost;
+    byte        *pixels;
+    int         x;
+
+    if (rpatch)
+        return rpatch;
+
+    patch = W_CacheLumpNum(firstspritelump + lump, PU_STATIC);
+    width = SHORT(patch->width);
+
+    // count the posts and pixels, skipping empty posts as R_DrawMaskedColumn() does
+    for (x = 0; x < width; x++)
+    {
+        column_t        *column = (column_t *)((byte *)patch + LONG(patch->columnofs[x]));
+
+        for (; column->topdelta != 0xff; column = (column_t *)((byte *)column + column->length + 4))
+            if (column->length)
+            {
+                numposts++;
+                numpixels += (column->length + 3) & ~3;
+            }
+    }
+
+    rpatch = Z_Malloc(sizeof(*rpatch) + width * sizeof(*rcolumn) + numposts * sizeof(*rpost)
+        + numpixels, PU_CACHE, (void **)&spritepatches[lump]);
+    rcolumn = (rcolumn_t *)(rpatch + 1);
+    rpost = (rpost_t *)(rcolumn + width);
+    pixels = (byte *)(rpost + numposts);
+
+    rpatch->width = width;
+    rpatch->columns = rcolumn;
+
+    for (x = 0; x < width; x++, rcolumn++)
+    {
+        column_t        *column = (column_t *)((byte *)patch + LONG(patch->columnofs[x]));
+
+        rcolumn->numposts = 0;
+        rcolumn->posts = rpost;
+
+        for (; column->topdelta != 0xff; column = (column_t *)((byte *)column + column->length + 4))
+            if (column->length)
+            {
+                rpost->topdelta = column->topdelta;
+                rpost->length = column->length;
+                rpost->pixels = pixels;
+                memcpy(pixels, (byte *)column + 3, column->length);
+                pixels += (column->length + 3) & ~3;
+                rpost++;
+                rcolumn->numposts++;
+            }
+    }
+
+    W_ReleaseLumpNum(firstspritelump + lump);
+
+    return rpatch;
 }
 
 //
@@ -364,6 +440,49 @@ void R_DrawMaskedColumn(column_t *column)
     }
 }
 
+//
+// R_DrawSpriteColumn
+// R_DrawMaskedColumn() for a column of a decoded sprite patch.
+//
+static void R_DrawSpriteColumn(const rcolumn_t *column)
+{
+    const rpost_t       *post = column->posts;
+    int                 i;
+
+    for (i = column->numposts; i > 0; i--, post++)
+    {
+        // calculate unclipped screen coordinates for post
+        int     topscreen = sprtopscreen + spryscale * post->topdelta + 1;
+
+        dc_yl = MAX((topscreen + FRACUNIT) >> FRACBITS, mceilingclip[dc_x] + 1);
+        dc_yh = MIN((topscreen + spryscale * post->length) >> FRACBITS, mfloorclip[dc_x] - 1);
+
+        dc_texturefrac = dc_texturemid - (post->topdelta << FRACBITS) +
+            FixedMul((dc_yl - centery) << FRACBITS, dc_iscale);
+
+        if (dc_texturefrac < 0)
+        {
+            int cnt = (FixedDiv(-dc_texturefrac, dc_iscale) + FRACUNIT - 1) >> FRACBITS;
+
+            dc_yl += cnt;
+            dc_texturefrac += cnt * dc_iscale;
+        }
+
+        {
+            const fixed_t       endfrac = dc_texturefrac + (dc_yh - dc_yl) * dc_iscale;
+            const fixed_t       maxfrac = post->length << FRACBITS;
+
+            if (endfrac >= maxfrac)
+                dc_yh -= (FixedDiv(endfrac - maxfrac - 1, dc_iscale) + FRACUNIT - 1) >> FRACBITS;
+        }
+
+        dc_source = post->pixels;
+
+        if (dc_yl >= 0 && dc_yh < viewheight && dc_yl <= dc_yh)
+            colfunc();
+    }
+}
+
 boolean megasphere;
 int     fuzzpos;
 
@@ -373,9 +492,8 @@ int     fuzzpos;
 //
 void R_DrawVisSprite(vissprite_t *vis)
 {
-    column_t    *column;
     fixed_t     frac;
-    patch_t     *patch = W_CacheLumpNum(vis->patch + firstspritelump, PU_CACHE);
+    rpatch_t    *patch = R_CacheSpritePatch(vis->patch);
 
     dc_colormap = vis->colormap;
     colfunc = vis->colfunc;
@@ -404,10 +522,7 @@ void R_DrawVisSprite(vissprite_t *vis)
     megasphere = (vis->type == MT_MEGA);
 
     for (dc_x = vis->x1; dc_x <= vis->x2; dc_x++, frac += vis->xiscale)
-    {
-        column = (column_t *)((byte *)patch + LONG(patch->columnofs[frac >> FRACBITS]));
-        R_DrawMaskedColumn(column);
-    }
+        R_DrawSpriteColumn(&patch->columns[frac >> FRACBITS]);
 
     colfunc = basecolfunc;
 }
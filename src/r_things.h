@@ -44,6 +44,7 @@ extern fixed_t  pspriteiscale;
 extern fixed_t  viewheightfrac;
 
 void R_DrawMaskedColumn(column_t *column);
+rpatch_t *R_CacheSpritePatch(int lump);
 
 void R_SortVisSprites(void);
 